@@ -3,8 +3,10 @@ layout(location=0) in vec3 aPos;
 
 uniform mat4 lightSpaceMatrix;
 uniform mat4 model;
+uniform vec3 posScale  = vec3(1.0);   // quantized meshes: aPos is unorm16 across the bounds
+uniform vec3 posOffset = vec3(0.0);
 
 void main()
 {
-    gl_Position = lightSpaceMatrix * model * vec4(aPos,1.0);
+    gl_Position = lightSpaceMatrix * model * vec4(aPos * posScale + posOffset,1.0);
 }
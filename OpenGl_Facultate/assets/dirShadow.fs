@@ -15,6 +15,10 @@ in VS_OUT{
 out vec4 FragColor;
 
 uniform sampler2D diffuseTex;
+uniform sampler2DArray atlasTex;    // small diffuse maps packed by TextureAtlas
+uniform bool  useAtlas;
+uniform int   atlasLayer;
+uniform vec4  atlasRect;            // xy offset, zw size in atlas UVs
 uniform sampler2D shadowMap;
 uniform bool  useTexture;
 uniform vec3  objectColor;
@@ -24,7 +28,12 @@ uniform float shininess;
 
 // ── helpers ────────────────────────────────────────────────────────────
 vec3 baseColor(){
-    return useTexture ? texture(diffuseTex,fs_in.Tex).rgb : objectColor;
+    if(!useTexture) return objectColor;
+    if(!useAtlas)   return texture(diffuseTex,fs_in.Tex).rgb;
+    // wrap inside the rect; gradients from the unwrapped UVs avoid a mip jump at the fract seam
+    vec2 uv = atlasRect.xy + fract(fs_in.Tex) * atlasRect.zw;
+    return textureGrad(atlasTex, vec3(uv, float(atlasLayer)),
+                       dFdx(fs_in.Tex) * atlasRect.zw, dFdy(fs_in.Tex) * atlasRect.zw).rgb;
 }
 float ShadowCalculation(vec4 fragPosLight)
 {
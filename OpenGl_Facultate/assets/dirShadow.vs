@@ -11,12 +11,25 @@ out VS_OUT{
 } vs_out;
 
 uniform mat4 model, view, projection, lightSpaceMatrix;
+// quantized meshes: aPos is unorm16 across the bounds, aNormal.xy octahedral
+uniform vec3 posScale  = vec3(1.0);
+uniform vec3 posOffset = vec3(0.0);
+uniform bool octNormals;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
 
 void main()
 {
-    vec4 world = model * vec4(aPos,1.0);
+    vec3 normal = octNormals ? octDecode(aNormal.xy) : aNormal;
+    vec4 world = model * vec4(aPos * posScale + posOffset,1.0);
     vs_out.FragPos      = world.xyz;
-    vs_out.Normal       = mat3(transpose(inverse(model))) * aNormal;
+    vs_out.Normal       = mat3(transpose(inverse(model))) * normal;
     vs_out.Tex          = aTex;
     vs_out.FragPosLight = lightSpaceMatrix * world;
     gl_Position         = projection * view * world;
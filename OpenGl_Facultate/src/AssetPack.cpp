@@ -0,0 +1,293 @@
+#include "AssetPack.h"
+#include <stb/stb_image.h>
+#include <stb/stb_image_write.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+// Defined by stb_image_write (for its PNG writer) but not declared in its header.
+extern "C" unsigned char* stbi_zlib_compress(unsigned char* data, int data_len, int* out_len, int quality);
+
+namespace {
+
+const char PACK_MAGIC[4] = { 'A', 'P', 'A', 'K' };
+
+const uint32_t COMPRESSION_NONE = 0;
+const uint32_t COMPRESSION_ZLIB = 1;
+
+struct PackHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t entryCount;
+};
+
+// Appends every regular file under dir, with '/' separators.
+void listFiles(const std::string& dir, std::vector<std::string>& out)
+{
+#ifdef _WIN32
+    WIN32_FIND_DATAA found;
+    HANDLE search = FindFirstFileA((dir + "/*").c_str(), &found);
+    if (search == INVALID_HANDLE_VALUE)
+        return;
+    do {
+        std::string name = found.cFileName;
+        if (name == "." || name == "..")
+            continue;
+        if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            listFiles(dir + "/" + name, out);
+        else
+            out.push_back(dir + "/" + name);
+    } while (FindNextFileA(search, &found));
+    FindClose(search);
+#else
+    DIR* d = opendir(dir.c_str());
+    if (!d)
+        return;
+    while (dirent* e = readdir(d)) {
+        std::string name = e->d_name;
+        if (name == "." || name == "..")
+            continue;
+        std::string path = dir + "/" + name;
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+            continue;
+        if (S_ISDIR(st.st_mode))
+            listFiles(path, out);
+        else if (S_ISREG(st.st_mode))
+            out.push_back(path);
+    }
+    closedir(d);
+#endif
+}
+
+bool isDirectory(const std::string& path)
+{
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesA(path.c_str());
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+#endif
+}
+
+}
+
+struct AssetPack::Entry {
+    uint64_t pathHash;
+    uint64_t offset;
+    uint64_t size;       // bytes in the pack
+    uint64_t rawSize;    // bytes once inflated
+    uint32_t compression;
+    uint32_t reserved;
+};
+
+AssetPack& AssetPack::instance()
+{
+    static AssetPack pack;
+    return pack;
+}
+
+uint64_t AssetPack::key(const std::string& path)
+{
+    // Case-folded on every platform, so a pack built on one OS resolves on another.
+    std::string p = normalizePath(path);
+    std::transform(p.begin(), p.end(), p.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return hashBytes(p.data(), p.size());
+}
+
+bool AssetPack::mount(const std::string& path)
+{
+    unmount();
+    if (!file.openFile(path))
+        return false;
+
+    PackHeader header;
+    if (file.size() < sizeof(header)) {
+        unmount();
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, PACK_MAGIC, 4) != 0 || header.version != ASSET_PACK_VERSION ||
+        (file.size() - sizeof(header)) / sizeof(Entry) < header.entryCount) {
+        std::cout << "ERROR::PACK::INVALID::" << path << std::endl;
+        unmount();
+        return false;
+    }
+    entries = reinterpret_cast<const Entry*>(file.data() + sizeof(header));
+    entryCount = (size_t)header.entryCount;
+    for (size_t i = 0; i < entryCount; i++) {
+        if (entries[i].offset > file.size() || file.size() - entries[i].offset < entries[i].size) {
+            std::cout << "ERROR::PACK::INVALID::" << path << std::endl;
+            unmount();
+            return false;
+        }
+    }
+    return true;
+}
+
+void AssetPack::unmount()
+{
+    file.close();
+    entries = nullptr;
+    entryCount = 0;
+}
+
+const AssetPack::Entry* AssetPack::lookup(const std::string& path) const
+{
+    if (!entryCount)
+        return nullptr;
+    uint64_t hash = key(path);
+    const Entry* end = entries + entryCount;
+    const Entry* it = std::lower_bound(entries, end, hash,
+        [](const Entry& e, uint64_t h) { return e.pathHash < h; });
+    return it != end && it->pathHash == hash ? it : nullptr;
+}
+
+bool AssetPack::contains(const std::string& path) const
+{
+    return lookup(path) != nullptr;
+}
+
+bool AssetPack::find(const std::string& path, const unsigned char*& data, size_t& size, std::vector<unsigned char>& inflated) const
+{
+    const Entry* e = lookup(path);
+    if (!e)
+        return false;
+    const unsigned char* stored = file.data() + e->offset;
+    if (e->compression == COMPRESSION_NONE) {
+        data = stored;
+        size = (size_t)e->size;
+        return true;
+    }
+
+    inflated.resize((size_t)e->rawSize);
+    int n = stbi_zlib_decode_buffer(reinterpret_cast<char*>(inflated.data()), (int)inflated.size(),
+        reinterpret_cast<const char*>(stored), (int)e->size);
+    if (n != (int)e->rawSize) {
+        std::cout << "ERROR::PACK::CORRUPT_ENTRY::" << path << std::endl;
+        inflated.clear();
+        return false;
+    }
+    data = inflated.data();
+    size = inflated.size();
+    return true;
+}
+
+bool AssetPack::build(const std::string& packPath, const std::vector<std::string>& inputs)
+{
+    std::vector<std::string> paths;
+    for (const std::string& input : inputs) {
+        if (isDirectory(input))
+            listFiles(input, paths);
+        else
+            paths.push_back(input);
+    }
+    // Half-written cache files are not assets.
+    paths.erase(std::remove_if(paths.begin(), paths.end(), [](const std::string& p) {
+        return p.size() >= 4 && p.compare(p.size() - 4, 4, ".tmp") == 0;
+    }), paths.end());
+
+    struct Pending {
+        Entry entry;
+        std::string path;
+        std::vector<unsigned char> bytes;
+    };
+    std::vector<Pending> files;
+    size_t rawTotal = 0, packedTotal = 0;
+    for (const std::string& path : paths) {
+        MappedFile source;
+        if (!source.openFile(path)) {
+            std::cout << "WARNING::PACK::SKIPPED::" << path << std::endl;
+            continue;
+        }
+        Pending p;
+        p.path = path;
+        p.entry = Entry();
+        p.entry.pathHash = key(path);
+        p.entry.rawSize = source.size();
+
+        // Keep the zlib stream only where it pays off; images are usually compressed already.
+        int zlibSize = 0;
+        unsigned char* zlib = stbi_zlib_compress(const_cast<unsigned char*>(source.data()), (int)source.size(), &zlibSize, 8);
+        if (zlib && (size_t)zlibSize < source.size() - source.size() / 8) {
+            p.entry.compression = COMPRESSION_ZLIB;
+            p.bytes.assign(zlib, zlib + zlibSize);
+        }
+        else {
+            p.entry.compression = COMPRESSION_NONE;
+            p.bytes.assign(source.data(), source.data() + source.size());
+        }
+        std::free(zlib);
+        p.entry.size = p.bytes.size();
+        rawTotal += source.size();
+        packedTotal += p.bytes.size();
+        files.push_back(std::move(p));
+    }
+
+    std::sort(files.begin(), files.end(), [](const Pending& a, const Pending& b) {
+        return a.entry.pathHash < b.entry.pathHash;
+    });
+    for (size_t i = 1; i < files.size(); i++) {
+        if (files[i].entry.pathHash == files[i - 1].entry.pathHash) {
+            std::cout << "ERROR::PACK::DUPLICATE_PATH::" << files[i - 1].path << " / " << files[i].path << std::endl;
+            return false;
+        }
+    }
+
+    // Data starts after the index, every file on a 16-byte boundary.
+    uint64_t offset = sizeof(PackHeader) + files.size() * sizeof(Entry);
+    for (Pending& p : files) {
+        offset = (offset + 15) & ~uint64_t(15);
+        p.entry.offset = offset;
+        offset += p.entry.size;
+    }
+
+    PackHeader header;
+    std::memcpy(header.magic, PACK_MAGIC, 4);
+    header.version = ASSET_PACK_VERSION;
+    header.entryCount = files.size();
+
+    std::string tmpPath = packPath + ".tmp";
+    {
+        std::ofstream f(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!f)
+            return false;
+        f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const Pending& p : files)
+            f.write(reinterpret_cast<const char*>(&p.entry), sizeof(Entry));
+        const char padding[16] = {};
+        uint64_t written = sizeof(PackHeader) + files.size() * sizeof(Entry);
+        for (const Pending& p : files) {
+            f.write(padding, (std::streamsize)(p.entry.offset - written));
+            f.write(reinterpret_cast<const char*>(p.bytes.data()), p.bytes.size());
+            written = p.entry.offset + p.entry.size;
+        }
+        if (!f) {
+            f.close();
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+    }
+    std::remove(packPath.c_str());
+    if (std::rename(tmpPath.c_str(), packPath.c_str()) != 0)
+        return false;
+
+    std::cout << "PACK::BUILD::" << packPath << " " << files.size() << " files, " << rawTotal / (1024.0 * 1024.0)
+        << " MB -> " << packedTotal / (1024.0 * 1024.0) << " MB" << std::endl;
+    return true;
+}
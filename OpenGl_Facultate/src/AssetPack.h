@@ -0,0 +1,47 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+
+// Bump whenever the pack layout changes.
+const uint32_t ASSET_PACK_VERSION = 1;
+
+// Single-file archive of the app's assets, read through one memory mapping.
+// The header is followed by an index sorted by path hash (offset, size, compression), then the file data.
+// Once mounted, MappedFile::open resolves paths against it before touching the disk.
+class AssetPack {
+public:
+    // Maps the pack, returns false if it is missing or invalid. Call before any loader thread starts.
+    bool mount(const std::string& path);
+    void unmount();
+
+    bool isMounted() const { return file.isOpen(); }
+    size_t fileCount() const { return entryCount; }
+    bool contains(const std::string& path) const;
+
+    // Finds a packed file. Stored entries point into the mapping; compressed ones are inflated into `inflated`.
+    // Safe to call from any thread while mounted.
+    bool find(const std::string& path, const unsigned char*& data, size_t& size, std::vector<unsigned char>& inflated) const;
+
+    // Writes a pack of the given files and directories (recursively), keyed by the paths the app will use.
+    static bool build(const std::string& packPath, const std::vector<std::string>& inputs);
+
+    static AssetPack& instance();
+
+private:
+    struct Entry;
+
+    MappedFile file;
+    const Entry* entries = nullptr;
+    size_t entryCount = 0;
+
+    AssetPack() = default;
+    const Entry* lookup(const std::string& path) const;
+    static uint64_t key(const std::string& path);
+};
+
+#endif
@@ -0,0 +1,43 @@
+#include "Frustum.h"
+
+Frustum::Frustum(const glm::mat4& m)
+{
+    // Gribb/Hartmann: each plane is the last row of the matrix plus or minus one of the others.
+    for (int i = 0; i < 3; i++) {
+        for (int side = 0; side < 2; side++) {
+            glm::vec4& p = planes[i * 2 + side];
+            float sign = side == 0 ? 1.0f : -1.0f;
+            for (int c = 0; c < 4; c++)
+                p[c] = m[c][3] + sign * m[c][i];
+            p /= glm::length(glm::vec3(p));
+        }
+    }
+}
+
+bool Frustum::intersects(const glm::vec3& center, const glm::vec3& extents, float margin) const
+{
+    for (const glm::vec4& p : planes) {
+        // Distance of the box's most inside corner along the plane normal.
+        float radius = glm::dot(extents, glm::abs(glm::vec3(p)));
+        if (glm::dot(glm::vec3(p), center) + p.w + radius + margin < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+bool Frustum::intersects(const glm::vec3& center, float radius) const
+{
+    for (const glm::vec4& p : planes)
+        if (glm::dot(glm::vec3(p), center) + p.w + radius < 0.0f)
+            return false;
+    return true;
+}
+
+bool Frustum::intersects(const glm::mat4& model, const glm::vec3& aabbMin, const glm::vec3& aabbMax, float margin) const
+{
+    // World-space box around the transformed one: |M| maps the half extents.
+    glm::vec3 center = glm::vec3(model * glm::vec4((aabbMin + aabbMax) * 0.5f, 1.0f));
+    glm::vec3 half = (aabbMax - aabbMin) * 0.5f;
+    glm::mat3 absolute = glm::mat3(glm::abs(glm::vec3(model[0])), glm::abs(glm::vec3(model[1])), glm::abs(glm::vec3(model[2])));
+    return intersects(center, absolute * half, margin);
+}
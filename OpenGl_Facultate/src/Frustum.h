@@ -0,0 +1,24 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+// The six clip planes of a view-projection matrix, normalized so plane distances are in world units.
+class Frustum {
+public:
+    explicit Frustum(const glm::mat4& viewProjection);
+
+    // True if the box is at least partly inside, with every plane pushed out by margin.
+    bool intersects(const glm::vec3& center, const glm::vec3& extents, float margin = 0.0f) const;
+
+    // True if the sphere is at least partly inside.
+    bool intersects(const glm::vec3& center, float radius) const;
+
+    // Same for an object-space box placed in the world by the model matrix.
+    bool intersects(const glm::mat4& model, const glm::vec3& aabbMin, const glm::vec3& aabbMax, float margin = 0.0f) const;
+
+private:
+    glm::vec4 planes[6];  // xyz normal pointing inside, w distance
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef GL_HANDLE_H
+#define GL_HANDLE_H
+
+#include <glad/glad.h>
+
+// Owns one GL object name and deletes it on destruction, so GPU memory goes away with its owner.
+// Move-only; a moved-from or default handle holds 0 and deletes nothing. Destroy on the GL thread,
+// while the context is still current.
+template <class Traits>
+class GLHandle {
+public:
+    GLHandle() = default;
+    explicit GLHandle(GLuint id) : id(id) {}
+    ~GLHandle() { reset(); }
+
+    GLHandle(const GLHandle&) = delete;
+    GLHandle& operator=(const GLHandle&) = delete;
+
+    GLHandle(GLHandle&& other) noexcept : id(other.release()) {}
+    GLHandle& operator=(GLHandle&& other) noexcept {
+        if (this != &other)
+            reset(other.release());
+        return *this;
+    }
+
+    // A fresh object from glGen* / glCreate*.
+    static GLHandle create() { return GLHandle(Traits::create()); }
+
+    GLuint get() const { return id; }
+    explicit operator bool() const { return id != 0; }
+
+    // Gives up ownership without deleting.
+    GLuint release() {
+        GLuint old = id;
+        id = 0;
+        return old;
+    }
+
+    // Deletes the current object and takes over another one.
+    void reset(GLuint newId = 0) {
+        if (id)
+            Traits::destroy(id);
+        id = newId;
+    }
+
+private:
+    GLuint id = 0;
+};
+
+struct GLVertexArrayTraits {
+    static GLuint create() { GLuint id; glGenVertexArrays(1, &id); return id; }
+    static void destroy(GLuint id) { glDeleteVertexArrays(1, &id); }
+};
+
+struct GLBufferTraits {
+    static GLuint create() { GLuint id; glGenBuffers(1, &id); return id; }
+    static void destroy(GLuint id) { glDeleteBuffers(1, &id); }
+};
+
+struct GLTextureTraits {
+    static GLuint create() { GLuint id; glGenTextures(1, &id); return id; }
+    static void destroy(GLuint id) { glDeleteTextures(1, &id); }
+};
+
+struct GLProgramTraits {
+    static GLuint create() { return glCreateProgram(); }
+    static void destroy(GLuint id) { glDeleteProgram(id); }
+};
+
+typedef GLHandle<GLVertexArrayTraits> GLVertexArray;
+typedef GLHandle<GLBufferTraits> GLBuffer;
+typedef GLHandle<GLTextureTraits> GLTexture;
+typedef GLHandle<GLProgramTraits> GLProgram;
+
+#endif
@@ -0,0 +1,173 @@
+#include "ImportBenchmark.h"
+#include "MappedIOSystem.h"
+#include "MemoryStats.h"
+#include "MeshCodec.h"
+#include "Model.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+int runImportBenchmark(const std::string& path, bool mappedIO, int runs)
+{
+    ImportOptions options = ImportOptions::FastRender();
+    size_t baseRSS = currentRSS();
+    double best = 1e30, total = 0.0;
+
+    for (int run = 0; run < runs; run++) {
+        auto start = std::chrono::steady_clock::now();
+        Assimp::Importer importer;
+        if (mappedIO)
+            importer.SetIOHandler(new MappedIOSystem());
+        const aiScene* scene = importer.ReadFile(path, options.postProcess);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (!scene || !scene->mRootNode) {
+            std::cout << "ERROR::BENCH::IMPORT::" << importer.GetErrorString() << std::endl;
+            return 1;
+        }
+        best = std::min(best, ms);
+        total += ms;
+    }
+
+    std::cout << "BENCH::IMPORT::" << path << " (" << (mappedIO ? "mapped io" : "default io") << ") "
+        << runs << " runs, best " << best << " ms, mean " << total / runs << " ms, peak RSS "
+        << peakRSS() / (1024.0 * 1024.0) << " MB (" << (peakRSS() - std::min(peakRSS(), baseRSS)) / (1024.0 * 1024.0)
+        << " MB above start)" << std::endl;
+    return 0;
+}
+
+namespace {
+
+// Best of runs, in seconds.
+template <class F>
+double bestTime(int runs, F&& body)
+{
+    double best = 1e30;
+    for (int run = 0; run < runs; run++) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+// Reads a whole file into memory, the way the cache would load without a mapping.
+bool readWholeFile(const std::string& path, std::vector<unsigned char>& out)
+{
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    if (!f)
+        return false;
+    out.resize((size_t)f.tellg());
+    f.seekg(0);
+    return (bool)f.read(reinterpret_cast<char*>(out.data()), out.size());
+}
+
+// Same triangles in the same order; the index codec keeps each one's winding but may rotate it.
+bool sameTriangles(const std::vector<unsigned int>& original, const std::vector<unsigned int>& decoded)
+{
+    if (original.size() != decoded.size())
+        return false;
+    for (size_t i = 0; i + 2 < original.size(); i += 3) {
+        const unsigned int* a = &original[i];
+        const unsigned int* b = &decoded[i];
+        bool match = false;
+        for (int r = 0; r < 3 && !match; r++)
+            match = a[0] == b[r] && a[1] == b[(r + 1) % 3] && a[2] == b[(r + 2) % 3];
+        if (!match)
+            return false;
+    }
+    return true;
+}
+
+}
+
+int runCodecBenchmark(const std::string& path, int runs)
+{
+    // The meshes exactly as the cooked cache would store them.
+    ImportOptions options = ImportOptions::FastRender();
+    options.report = false;
+    std::vector<MeshData> meshes;
+    if (!Model::ImportMeshes(path, options, meshes))
+        return 1;
+
+    size_t vertexBytes = 0, indexBytes = 0, vertexEncoded = 0, indexEncoded = 0;
+    std::vector<std::vector<unsigned char>> encodedVertices, encodedIndices;
+    double encodeSeconds = bestTime(1, [&]() {
+        for (const MeshData& m : meshes) {
+            encodedVertices.push_back(encodeVertexBuffer(m.vertices.data(), m.vertices.size(), sizeof(Vertex)));
+            encodedIndices.push_back(encodeIndexBuffer(m.indices.data(), m.indices.size()));
+        }
+    });
+    for (size_t i = 0; i < meshes.size(); i++) {
+        vertexBytes += meshes[i].vertices.size() * sizeof(Vertex);
+        indexBytes += meshes[i].indices.size() * sizeof(unsigned int);
+        vertexEncoded += encodedVertices[i].size();
+        indexEncoded += encodedIndices[i].size();
+    }
+    if (vertexBytes == 0) {
+        std::cout << "ERROR::BENCH::CODEC::no geometry in " << path << std::endl;
+        return 1;
+    }
+
+    // Round trip: vertices must come back bit for bit, indices as the same triangles.
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    for (size_t i = 0; i < meshes.size(); i++) {
+        vertices.resize(meshes[i].vertices.size());
+        indices.resize(meshes[i].indices.size());
+        bool ok = decodeVertexBuffer(vertices.data(), vertices.size(), sizeof(Vertex), encodedVertices[i].data(), encodedVertices[i].size()) &&
+            decodeIndexBuffer(indices.data(), indices.size(), encodedIndices[i].data(), encodedIndices[i].size()) &&
+            (vertices.empty() || std::memcmp(vertices.data(), meshes[i].vertices.data(), vertices.size() * sizeof(Vertex)) == 0) &&
+            sameTriangles(meshes[i].indices, indices);
+        if (!ok) {
+            std::cout << "ERROR::BENCH::CODEC::round trip failed on mesh " << i << std::endl;
+            return 1;
+        }
+    }
+
+    double vertexSeconds = bestTime(runs, [&]() {
+        for (size_t i = 0; i < meshes.size(); i++) {
+            vertices.resize(meshes[i].vertices.size());
+            decodeVertexBuffer(vertices.data(), vertices.size(), sizeof(Vertex), encodedVertices[i].data(), encodedVertices[i].size());
+        }
+    });
+    double indexSeconds = bestTime(runs, [&]() {
+        for (size_t i = 0; i < meshes.size(); i++) {
+            indices.resize(meshes[i].indices.size());
+            decodeIndexBuffer(indices.data(), indices.size(), encodedIndices[i].data(), encodedIndices[i].size());
+        }
+    });
+
+    // What decoding has to beat: reading the uncompressed cache. Both files are read back right after
+    // being written, so from the OS file cache; a cold disk read favours the smaller file further.
+    std::string rawPath = path + ".bench-raw.meshcache", compressedPath = path + ".bench-codec.meshcache";
+    std::vector<unsigned char> file;
+    size_t rawFileBytes = 0, compressedFileBytes = 0;
+    bool written = CookedModel::write(rawPath, 0, meshes, std::vector<EncodedImage>(), false) &&
+        CookedModel::write(compressedPath, 0, meshes, std::vector<EncodedImage>(), true);
+    bool read = written;
+    double rawReadSeconds = bestTime(runs, [&]() { read &= readWholeFile(rawPath, file); });
+    rawFileBytes = file.size();
+    double compressedReadSeconds = bestTime(runs, [&]() { read &= readWholeFile(compressedPath, file); });
+    compressedFileBytes = file.size();
+    std::remove(rawPath.c_str());
+    std::remove(compressedPath.c_str());
+
+    const double MB = 1024.0 * 1024.0, GB = 1e9;
+    std::cout << "BENCH::CODEC::" << path << " " << meshes.size() << " meshes, encoded in " << encodeSeconds * 1000.0 << " ms" << std::endl;
+    std::cout << "BENCH::CODEC::vertices " << vertexBytes / MB << " MB -> " << vertexEncoded / MB << " MB ("
+        << (double)vertexBytes / vertexEncoded << "x), decode " << vertexBytes / vertexSeconds / GB << " GB/s" << std::endl;
+    std::cout << "BENCH::CODEC::indices " << indexBytes / MB << " MB -> " << indexEncoded / MB << " MB ("
+        << (double)indexBytes / indexEncoded << "x, " << indexEncoded * 8.0 / (indexBytes / sizeof(unsigned int) / 3)
+        << " bits/triangle), decode " << indexBytes / indexSeconds / GB << " GB/s" << std::endl;
+    if (!read) {
+        std::cout << "ERROR::BENCH::CODEC::could not write or read the cache files next to " << path << std::endl;
+        return 1;
+    }
+    std::cout << "BENCH::CODEC::raw cache " << rawFileBytes / MB << " MB read in " << rawReadSeconds * 1000.0
+        << " ms; compressed cache " << compressedFileBytes / MB << " MB read in " << compressedReadSeconds * 1000.0
+        << " ms + decode " << (vertexSeconds + indexSeconds) * 1000.0 << " ms" << std::endl;
+    return 0;
+}
@@ -0,0 +1,14 @@
+#ifndef IMPORT_BENCHMARK_H
+#define IMPORT_BENCHMARK_H
+
+#include <string>
+
+// Imports a model several times without a GL context and prints the timings and peak RSS.
+// Peak RSS never goes down, so compare IO handlers across separate runs of the process.
+int runImportBenchmark(const std::string& path, bool mappedIO, int runs = 5);
+
+// Imports a model as FastRender would cook it, checks that MeshCodec round-trips it, then prints the
+// compression ratios and best-of-runs decode rates, and the time to read the raw and compressed caches.
+int runCodecBenchmark(const std::string& path, int runs = 5);
+
+#endif
@@ -0,0 +1,172 @@
+#include "MappedFile.h"
+#include "AssetPack.h"
+#include <algorithm>
+#include <cctype>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+bool endsWith(const std::string& s, const std::string& suffix)
+{
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Caches the program rewrites next to their source. A packed copy goes stale once that happens.
+bool isDerivedCache(const std::string& path)
+{
+    return endsWith(path, ".meshcache") || endsWith(path, ".dxt");
+}
+
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+    // Derived caches prefer the disk, where a re-cook writes its fresh copy; the pack is their fallback.
+    if (isDerivedCache(path) && openFile(path))
+        return true;
+    const AssetPack& pack = AssetPack::instance();
+    if (pack.isMounted() && pack.find(path, bytes, length, inflated))
+        return true;
+    return !isDerivedCache(path) && openFile(path);
+}
+
+#ifdef _WIN32
+bool MappedFile::openFile(const std::string& path)
+{
+    close();
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+    bytes = static_cast<const unsigned char*>(view);
+    length = static_cast<size_t>(fileSize.QuadPart);
+    mapped = true;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mapped)
+        UnmapViewOfFile(bytes);
+    if (mappingHandle)
+        CloseHandle(mappingHandle);
+    if (fileHandle)
+        CloseHandle(fileHandle);
+    bytes = nullptr;
+    length = 0;
+    mapped = false;
+    std::vector<unsigned char>().swap(inflated);
+    fileHandle = mappingHandle = nullptr;
+}
+#else
+bool MappedFile::openFile(const std::string& path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);   // the mapping keeps its own reference
+    if (view == MAP_FAILED)
+        return false;
+
+    bytes = static_cast<const unsigned char*>(view);
+    length = static_cast<size_t>(st.st_size);
+    mapped = true;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mapped)
+        munmap(const_cast<unsigned char*>(bytes), length);
+    bytes = nullptr;
+    length = 0;
+    mapped = false;
+    std::vector<unsigned char>().swap(inflated);
+}
+#endif
+
+std::string normalizePath(const std::string& path)
+{
+    std::string p = path;
+    std::replace(p.begin(), p.end(), '\\', '/');
+#ifdef _WIN32
+    std::transform(p.begin(), p.end(), p.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+#endif
+
+    // Split on '/', drop empty and "." segments, let ".." eat the previous one.
+    bool absolute = !p.empty() && p[0] == '/';
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while (start <= p.size()) {
+        size_t end = p.find('/', start);
+        if (end == std::string::npos)
+            end = p.size();
+        std::string part = p.substr(start, end - start);
+        if (part == "..") {
+            if (!parts.empty() && parts.back() != "..")
+                parts.pop_back();
+            else if (!absolute)
+                parts.push_back(part);
+        }
+        else if (!part.empty() && part != ".") {
+            parts.push_back(part);
+        }
+        start = end + 1;
+    }
+
+    std::string out = absolute ? "/" : "";
+    for (size_t i = 0; i < parts.size(); i++) {
+        if (i)
+            out += '/';
+        out += parts[i];
+    }
+    return out;
+}
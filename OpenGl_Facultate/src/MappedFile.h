@@ -0,0 +1,57 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read-only memory mapping of a whole file.
+// Files in the mounted AssetPack are served from the pack's mapping instead.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Maps the file at path, returns false if it can't be opened or is empty.
+    // .meshcache and .dxt caches come from disk before the pack, everything else from the pack first.
+    bool open(const std::string& path);
+    // Maps the file on disk, ignoring any mounted pack.
+    bool openFile(const std::string& path);
+    void close();
+
+    bool isOpen() const { return bytes != nullptr; }
+    const unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const unsigned char* bytes = nullptr;
+    size_t length = 0;
+    bool mapped = false;  // false when the bytes belong to the pack or to inflated
+    std::vector<unsigned char> inflated;  // compressed pack entries
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
+
+// Canonical form of a path, used as the key for files, pack entries and textures: forward slashes,
+// no "." or ".." segments, lower case on Windows.
+std::string normalizePath(const std::string& path);
+
+// 64-bit FNV-1a, used to content-hash source assets for the on-disk caches.
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint64_t h = seed;
+    for (size_t i = 0; i < size; i++) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+#endif
@@ -0,0 +1,99 @@
+#include "MappedIOSystem.h"
+#include "AssetPack.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+std::string MappedIOSystem::key(const char* path)
+{
+    return normalizePath(path);
+}
+
+void MappedIOSystem::addMemoryFile(const std::string& path, const unsigned char* data, size_t size)
+{
+    memoryFiles[key(path.c_str())] = MemoryFile{ data, size };
+}
+
+bool MappedIOSystem::Exists(const char* pFile) const
+{
+    if (memoryFiles.count(key(pFile)))
+        return true;
+    const AssetPack& pack = AssetPack::instance();
+    if (pack.isMounted() && pack.contains(pFile))
+        return true;
+    // Only the metadata; Open maps the file once the importer actually reads it.
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesA(pFile);
+    return attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat info;
+    return stat(pFile, &info) == 0 && S_ISREG(info.st_mode);
+#endif
+}
+
+Assimp::IOStream* MappedIOSystem::Open(const char* pFile, const char* pMode)
+{
+    // Read-only: the importers never write.
+    if (std::strchr(pMode, 'w') || std::strchr(pMode, 'a') || std::strchr(pMode, '+'))
+        return nullptr;
+
+    auto memory = memoryFiles.find(key(pFile));
+    if (memory != memoryFiles.end())
+        return new MappedIOStream(memory->second.data, memory->second.size);
+
+    std::unique_ptr<MappedFile> mapping(new MappedFile());
+    if (!mapping->open(pFile))
+        return nullptr;
+    const unsigned char* data = mapping->data();
+    size_t size = mapping->size();
+    return new MappedIOStream(data, size, std::move(mapping));
+}
+
+void MappedIOSystem::Close(Assimp::IOStream* pFile)
+{
+    delete pFile;
+}
+
+MappedIOStream::MappedIOStream(const unsigned char* data, size_t size, std::unique_ptr<MappedFile> mapping)
+    : mapping(std::move(mapping)), data(data), size(size)
+{
+}
+
+size_t MappedIOStream::Read(void* pvBuffer, size_t pSize, size_t pCount)
+{
+    if (pSize == 0 || pCount == 0)
+        return 0;
+    // Like fread: only whole elements, returns how many were read.
+    size_t count = std::min(pCount, (size - position) / pSize);
+    std::memcpy(pvBuffer, data + position, count * pSize);
+    position += count * pSize;
+    return count;
+}
+
+size_t MappedIOStream::Write(const void*, size_t, size_t)
+{
+    return 0;
+}
+
+aiReturn MappedIOStream::Seek(size_t pOffset, aiOrigin pOrigin)
+{
+    size_t target;
+    switch (pOrigin) {
+    case aiOrigin_SET: target = pOffset; break;
+    case aiOrigin_CUR: target = position + pOffset; break;
+    case aiOrigin_END: target = size - pOffset; break;
+    default: return aiReturn_FAILURE;
+    }
+    if (target > size)
+        return aiReturn_FAILURE;
+    position = target;
+    return aiReturn_SUCCESS;
+}
@@ -0,0 +1,52 @@
+#ifndef MAPPED_IO_SYSTEM_H
+#define MAPPED_IO_SYSTEM_H
+
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "MappedFile.h"
+
+// Read-only Assimp IO that serves files from memory mappings instead of buffered fread copies.
+// Files registered with addMemoryFile (e.g. from an asset pack) are served from memory and never touch the disk.
+class MappedIOSystem : public Assimp::IOSystem {
+public:
+    // Makes path resolve to caller-owned bytes, which must outlive the importer.
+    void addMemoryFile(const std::string& path, const unsigned char* data, size_t size);
+
+    bool Exists(const char* pFile) const override;
+    char getOsSeparator() const override { return '/'; }
+    Assimp::IOStream* Open(const char* pFile, const char* pMode = "rb") override;
+    void Close(Assimp::IOStream* pFile) override;
+
+private:
+    struct MemoryFile {
+        const unsigned char* data;
+        size_t size;
+    };
+    std::unordered_map<std::string, MemoryFile> memoryFiles;
+
+    static std::string key(const char* path);
+};
+
+// Stream over a byte range, optionally owning the mapping it points into.
+class MappedIOStream : public Assimp::IOStream {
+public:
+    MappedIOStream(const unsigned char* data, size_t size, std::unique_ptr<MappedFile> mapping = nullptr);
+
+    size_t Read(void* pvBuffer, size_t pSize, size_t pCount) override;
+    size_t Write(const void* pvBuffer, size_t pSize, size_t pCount) override;
+    aiReturn Seek(size_t pOffset, aiOrigin pOrigin) override;
+    size_t Tell() const override { return position; }
+    size_t FileSize() const override { return size; }
+    void Flush() override {}
+
+private:
+    std::unique_ptr<MappedFile> mapping;
+    const unsigned char* data;
+    size_t size;
+    size_t position = 0;
+};
+
+#endif
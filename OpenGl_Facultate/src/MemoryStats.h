@@ -0,0 +1,11 @@
+#ifndef MEMORY_STATS_H
+#define MEMORY_STATS_H
+
+#include <cstddef>
+
+// Resident set size of this process in bytes, 0 where unsupported.
+size_t currentRSS();
+// Highest resident set size this process has reached, in bytes.
+size_t peakRSS();
+
+#endif
@@ -1,39 +1,179 @@
 #include "Mesh.h"
+#include "MeshOptimizer.h"
+#include "Meshlets.h"
 #include <glad/glad.h>
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <cmath>
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures)
-    : vertices(vertices), indices(indices), textures(textures)
+namespace {
+
+int16_t toSnorm16(float v) {
+    return static_cast<int16_t>(std::round(std::max(-1.0f, std::min(1.0f, v)) * 32767.0f));
+}
+
+// Octahedral encoding: project onto |x|+|y|+|z| = 1, fold the lower half over the diagonals.
+void encodeNormal(const glm::vec3& n, int16_t out[2]) {
+    float sum = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    glm::vec2 p = sum > 0.0f ? glm::vec2(n.x, n.y) / sum : glm::vec2(0.0f);
+    if (sum > 0.0f && n.z < 0.0f) {
+        glm::vec2 folded = (1.0f - glm::abs(glm::vec2(p.y, p.x)));
+        p = glm::vec2(p.x >= 0.0f ? folded.x : -folded.x, p.y >= 0.0f ? folded.y : -folded.y);
+    }
+    out[0] = toSnorm16(p.x);
+    out[1] = toSnorm16(p.y);
+}
+
+// unorm16 across the bounds; w is padding so a position stays 8-byte aligned.
+void quantizePosition(const glm::vec3& p, const glm::vec3& offset, const glm::vec3& inverseScale, uint16_t out[4]) {
+    glm::vec3 q = glm::round(glm::clamp((p - offset) * inverseScale, 0.0f, 1.0f) * 65535.0f);
+    out[0] = static_cast<uint16_t>(q.x);
+    out[1] = static_cast<uint16_t>(q.y);
+    out[2] = static_cast<uint16_t>(q.z);
+    out[3] = 0;
+}
+
+glm::vec3 inverseScale(const glm::vec3& scale) {
+    // A flat axis still needs a non-zero divisor; every vertex lands on 0 there.
+    return glm::vec3(
+        scale.x > 0.0f ? 1.0f / scale.x : 0.0f,
+        scale.y > 0.0f ? 1.0f / scale.y : 0.0f,
+        scale.z > 0.0f ? 1.0f / scale.z : 0.0f);
+}
+
+}
+
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, bool quantize,
+    std::vector<MeshLod> lods, bool positionStream)
+    : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)), quantized(quantize),
+    lods(std::move(lods))
+{
+    setupMesh(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size(), positionStream);
+}
+
+Mesh::Mesh(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount,
+    std::vector<Texture> textures, bool quantize, std::vector<MeshLod> lods, bool positionStream)
+    : textures(std::move(textures)), quantized(quantize), lods(std::move(lods))
 {
-    setupMesh();
+    setupMesh(vertices, vertexCount, indices, indexCount, positionStream);
 }
 
-void Mesh::setupMesh() {
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
+void Mesh::setupMesh(const Vertex* vertexData, size_t vertexCount, const unsigned int* indexData, size_t indexCount,
+    bool positionStream) {
+    this->vertexCount = static_cast<unsigned int>(vertexCount);
+    this->indexCount = static_cast<unsigned int>(indexCount);
+    if (lods.empty())
+        lods.push_back(MeshLod{ 0, this->indexCount, 0.0f });
 
-    glBindVertexArray(VAO);
+    VAO = GLVertexArray::create();
+    VBO = GLBuffer::create();
+    EBO = GLBuffer::create();
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    glBindVertexArray(VAO.get());
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO.get());
+    if (quantized)
+        uploadPacked(vertexData, vertexCount);
+    else
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertexData, GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO.get());
+    if (vertexCount <= MAX_SHORT_INDEX_VERTICES) {
+        // Half the index memory and fetch bandwidth; the CPU copy stays 32-bit
+        std::vector<uint16_t> shortIndices(indexData, indexData + indexCount);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(uint16_t), shortIndices.data(), GL_STATIC_DRAW);
+        indexType = GL_UNSIGNED_SHORT;
+    }
+    else {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indexData, GL_STATIC_DRAW);
+        indexType = GL_UNSIGNED_INT;
+    }
 
-    // Vertex positions
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-    // Vertex normals
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-    // Vertex texture coordinates
     glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+    if (quantized) {
+        // Normalized integers come out as [0,1] positions and [-1,1] octahedral coordinates
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Position));
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Normal));
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, TexCoords));
+    }
+    else {
+        // Vertex positions
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        // Vertex normals
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+        // Vertex texture coordinates
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+    }
 
     glBindVertexArray(0);
+    if (positionStream)
+        setupPositionStream(vertexData, vertexCount);
+}
+
+void Mesh::setupPositionStream(const Vertex* vertexData, size_t vertexCount) {
+    depthVAO = GLVertexArray::create();
+    positionVBO = GLBuffer::create();
+    glBindVertexArray(depthVAO.get());
+    glBindBuffer(GL_ARRAY_BUFFER, positionVBO.get());
+    if (quantized) {
+        // Same quantization as the PackedVertex, so both passes land on identical depths
+        glm::vec3 inverse = inverseScale(posScale);
+        std::vector<uint16_t> packed(vertexCount * 4);
+        for (size_t i = 0; i < vertexCount; i++)
+            quantizePosition(vertexData[i].Position, posOffset, inverse, &packed[i * 4]);
+        glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(uint16_t), packed.data(), GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, 4 * sizeof(uint16_t), (void*)0);
+    }
+    else {
+        std::vector<glm::vec3> packed(vertexCount);
+        for (size_t i = 0; i < vertexCount; i++)
+            packed[i] = vertexData[i].Position;
+        glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(glm::vec3), packed.data(), GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+    }
+    glEnableVertexAttribArray(0);
+    // The element buffer binding is VAO state, so the index buffer is shared, not copied
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO.get());
+    glBindVertexArray(0);
 }
 
-void Mesh::Draw(Shader& shader) {
+unsigned int Mesh::vertexArrayFor(const Shader& shader) const {
+    return shader.positionOnly && depthVAO ? depthVAO.get() : VAO.get();
+}
+
+void Mesh::uploadPacked(const Vertex* vertexData, size_t vertexCount) {
+    glm::vec3 lo(0.0f), hi(0.0f);
+    if (vertexCount) {
+        lo = hi = vertexData[0].Position;
+        for (size_t i = 0; i < vertexCount; i++) {
+            lo = glm::min(lo, vertexData[i].Position);
+            hi = glm::max(hi, vertexData[i].Position);
+        }
+    }
+    posOffset = lo;
+    posScale = hi - lo;
+    glm::vec3 inverse = inverseScale(posScale);
+
+    std::vector<PackedVertex> packed(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++) {
+        const Vertex& v = vertexData[i];
+        PackedVertex& p = packed[i];
+        quantizePosition(v.Position, lo, inverse, p.Position);
+        encodeNormal(v.Normal, p.Normal);
+        p.TexCoords[0] = glm::packHalf1x16(v.TexCoords.x);
+        p.TexCoords[1] = glm::packHalf1x16(v.TexCoords.y);
+    }
+    glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(PackedVertex), packed.data(), GL_STATIC_DRAW);
+}
+
+void Mesh::bindMaterial(Shader& shader) {
+    // Dequantization; Model::Draw puts back the float layout's identity values afterwards
+    shader.setVec3("posScale", posScale);
+    shader.setVec3("posOffset", posOffset);
+    if (shader.positionOnly)
+        return;
     unsigned int diffuseNr = 1;
     unsigned int specularNr = 1;
     for (unsigned int i = 0; i < textures.size(); i++) {
@@ -48,8 +188,80 @@ void Mesh::Draw(Shader& shader) {
         glBindTexture(GL_TEXTURE_2D, textures[i].id);
     }
     glActiveTexture(GL_TEXTURE0);
+    shader.setBool("octNormals", quantized);
+    // A packed diffuse texture is sampled from the atlas Model::Draw bound
+    shader.setBool("useAtlas", atlasLayer >= 0);
+    if (atlasLayer >= 0) {
+        shader.setInt("atlasLayer", atlasLayer);
+        shader.setVec4("atlasRect", atlasRect);
+    }
+}
 
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
+void Mesh::Draw(Shader& shader, int lod) {
+    bindMaterial(shader);
+    glBindVertexArray(vertexArrayFor(shader));
+    const MeshLod& level = lods[std::min<size_t>(std::max(lod, 0), lods.size() - 1)];
+    size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+    glDrawElements(GL_TRIANGLES, level.indexCount, indexType, (void*)(level.indexOffset * indexSize));
     glBindVertexArray(0);
 }
+
+void Mesh::Draw(Shader& shader, const ClusterCulling& culling) {
+    if (meshlets.empty()) {
+        Draw(shader, 0);
+        return;
+    }
+    // Visible clusters next to each other in the index buffer become one range.
+    size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+    drawCounts.clear();
+    drawOffsets.clear();
+    uint32_t rangeEnd = 0;
+    for (const Meshlet& m : meshlets) {
+        if (!culling.visible(m))
+            continue;
+        if (!drawCounts.empty() && m.indexOffset == rangeEnd)
+            drawCounts.back() += m.indexCount;
+        else {
+            drawCounts.push_back(m.indexCount);
+            drawOffsets.push_back((const void*)(m.indexOffset * indexSize));
+        }
+        rangeEnd = m.indexOffset + m.indexCount;
+    }
+    if (drawCounts.empty())
+        return;
+
+    bindMaterial(shader);
+    glBindVertexArray(vertexArrayFor(shader));
+    glMultiDrawElements(GL_TRIANGLES, drawCounts.data(), indexType, drawOffsets.data(), (GLsizei)drawCounts.size());
+    glBindVertexArray(0);
+}
+
+void Mesh::releaseCpuData(MeshResidency residency) {
+    if (residency == MeshResidency::Keep)
+        return;
+    if (residency == MeshResidency::KeepPositions) {
+        positions.resize(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+            positions[i] = vertices[i].Position;
+    }
+    else {
+        // swap, not clear, so the memory actually goes back to the heap
+        std::vector<unsigned int>().swap(indices);
+    }
+    std::vector<Vertex>().swap(vertices);
+}
+
+size_t Mesh::indexBytes() const {
+    return (size_t)indexCount * (indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int));
+}
+
+size_t Mesh::vertexBytes() const {
+    size_t full = (size_t)vertexCount * (quantized ? sizeof(PackedVertex) : sizeof(Vertex));
+    size_t stream = depthVAO ? (size_t)vertexCount * (quantized ? 4 * sizeof(uint16_t) : sizeof(glm::vec3)) : 0;
+    return full + stream;
+}
+
+size_t Mesh::cpuBytes() const {
+    return vertices.capacity() * sizeof(Vertex) + positions.capacity() * sizeof(glm::vec3)
+        + indices.capacity() * sizeof(unsigned int);
+}
@@ -1,9 +1,11 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include <cstdint>
 #include <glm/glm.hpp>
 #include <string>
 #include <vector>
+#include "GLHandle.h"
 #include "shader.h"
 
 // Data structures for a single vertex and a texture.
@@ -13,28 +15,142 @@ struct Vertex {
     glm::vec2 TexCoords;
 };
 
+// Compact 16-byte vertex: position quantized to the mesh bounds, octahedral normal, half-float UVs.
+struct PackedVertex {
+    uint16_t Position[4];   // unorm16 across the bounds, w unused
+    int16_t Normal[2];      // snorm16 octahedral encoding
+    uint16_t TexCoords[2];  // half floats
+};
+
 struct Texture {
     unsigned int id;
     std::string type;
     std::string path;
 };
 
+// One level of detail: a range of the mesh's index buffer and its geometric error in object units.
+struct MeshLod {
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    float error;
+};
+
+// A small cluster of triangles: a range of the index buffer with a bounding sphere and a cone around its normals.
+// The cluster faces away from every eye e with dot(center - e, coneAxis) > coneCutoff * |center - e| + radius.
+struct Meshlet {
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    glm::vec3 center;
+    float radius;
+    glm::vec3 coneAxis;
+    float coneCutoff;    // sine of the cone's half angle; 1 when the normals span a hemisphere or more
+};
+
+struct ClusterCulling;
+
+// CPU-side result of importing one mesh, before anything is uploaded to the GPU.
+// Texture ids are left at 0 here and resolved by the Model on upload.
+struct MeshData {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<Texture> textures;
+    glm::vec3 aabbMin = glm::vec3(0.0f);
+    glm::vec3 aabbMax = glm::vec3(0.0f);
+    // Levels of detail stored back to back in indices, finest first; empty means one level of all indices.
+    std::vector<MeshLod> lods;
+    // Clusters of the full-detail level, whose indices are already ordered by cluster; empty if not built.
+    std::vector<Meshlet> meshlets;
+};
+
+// What a mesh keeps in system memory once its buffers are uploaded.
+enum class MeshResidency {
+    Keep,                // vertices and indices stay, e.g. for tools that edit them
+    DiscardAfterUpload,  // the GPU copy is the only one
+    KeepPositions,       // positions and indices stay for CPU picking and culling
+};
+
 class Mesh {
 public:
     // Mesh Data
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     std::vector<Texture> textures;
-    unsigned int VAO;
+    // Filled by releaseCpuData(KeepPositions)
+    std::vector<glm::vec3> positions;
+    GLVertexArray VAO;
+    // Uploaded as PackedVertex; the shader maps positions back with aPos * posScale + posOffset
+    bool quantized = false;
+    // Second VAO over a tightly packed copy of the positions (12 bytes, 8 when quantized) and the same
+    // index buffer, used for position-only programs; 0 if the mesh wasn't built with one
+    GLVertexArray depthVAO;
+    glm::vec3 posScale = glm::vec3(1.0f);
+    glm::vec3 posOffset = glm::vec3(0.0f);
+    // Counts of the uploaded buffers, valid whatever was released
+    unsigned int vertexCount = 0;
+    unsigned int indexCount = 0;
+    // GL_UNSIGNED_SHORT when every index fits in 16 bits, GL_UNSIGNED_INT otherwise
+    unsigned int indexType = 0;
+    // Ranges of the index buffer, finest first; level 0 always exists
+    std::vector<MeshLod> lods;
+    // Clusters of level 0, for culling below mesh granularity; empty if none were built
+    std::vector<Meshlet> meshlets;
+    // Object-space bounding box
+    glm::vec3 aabbMin = glm::vec3(0.0f);
+    glm::vec3 aabbMax = glm::vec3(0.0f);
+    // Largest UV span, i.e. how many times the textures repeat across the mesh
+    float uvExtent = 1.0f;
+    // Diffuse texture packed into the model's atlas: array layer (-1 if none) and UV rectangle
+    int atlasLayer = -1;
+    glm::vec4 atlasRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+
+    // Constructor, uploads the vertices as PackedVertex when quantize is set. Takes the vectors over,
+    // so pass them with std::move. lods index into indices; empty means a single level of all of them.
+    // positionStream adds the depth-only stream.
+    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, bool quantize = false,
+        std::vector<MeshLod> lods = std::vector<MeshLod>(), bool positionStream = false);
+    // Same, uploading straight from memory the mesh doesn't own (e.g. the cooked cache mapping) and keeping
+    // no CPU copy, as after releaseCpuData(DiscardAfterUpload).
+    Mesh(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount,
+        std::vector<Texture> textures, bool quantize = false, std::vector<MeshLod> lods = std::vector<MeshLod>(),
+        bool positionStream = false);
+
+    // Owns its GL buffers: moving hands them over, destruction deletes them.
+    Mesh(Mesh&&) = default;
+    Mesh& operator=(Mesh&&) = default;
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    // Render the mesh at the given level of detail
+    void Draw(Shader& shader, int lod = 0);
+    // Render level 0 without the clusters culling rejects, merging neighbouring ranges into one multi-draw
+    void Draw(Shader& shader, const ClusterCulling& culling);
+
+    // Frees the CPU-side copies the policy doesn't keep. Call after the mesh is uploaded.
+    void releaseCpuData(MeshResidency residency);
+
+    // Bytes of vertex, position and index data held in system memory.
+    size_t cpuBytes() const;
 
-    // Constructor
-    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
+    // Bytes of the uploaded index buffer.
+    size_t indexBytes() const;
 
-    // Render the mesh
-    void Draw(Shader& shader);
+    // Bytes of the uploaded vertex buffers, the position stream included.
+    size_t vertexBytes() const;
 private:
-    unsigned int VBO, EBO;
-    void setupMesh();
+    GLBuffer VBO, EBO, positionVBO;
+    // Reused by the culled draw so it doesn't allocate every frame
+    std::vector<GLsizei> drawCounts;
+    std::vector<const void*> drawOffsets;
+    void setupMesh(const Vertex* vertexData, size_t vertexCount, const unsigned int* indexData, size_t indexCount,
+        bool positionStream);
+    // Fills the position-only buffer and its VAO.
+    void setupPositionStream(const Vertex* vertexData, size_t vertexCount);
+    // The VAO the shader reads from.
+    unsigned int vertexArrayFor(const Shader& shader) const;
+    // Binds the textures and sets the per-mesh uniforms; only the dequantization for position-only programs.
+    void bindMaterial(Shader& shader);
+    // Quantizes the vertices to PackedVertex and fills the bound array buffer.
+    void uploadPacked(const Vertex* vertexData, size_t vertexCount);
 };
 
 #endif
@@ -0,0 +1,318 @@
+#include "MeshCache.h"
+#include "MeshCodec.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+const char CACHE_MAGIC[4] = { 'M', 'S', 'H', 'C' };
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash;
+    uint32_t meshCount;
+    uint32_t vertexSize;
+    uint32_t imageCount;  // ImageRecords right after the MeshRecords
+    uint32_t padding;
+};
+
+struct MeshRecord {
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t textureOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t textureCount;
+    float aabbMin[3];
+    float aabbMax[3];
+    uint32_t lodCount;  // MeshLod entries right after the texture strings
+    uint32_t vertexEncodedSize;  // MeshCodec bytes, 0 if the vertices are stored raw
+    uint32_t indexEncodedSize;   // same for the indices
+    uint32_t meshletCount;       // Meshlet entries right after the LODs
+};
+
+struct ImageRecord {
+    uint64_t offset;
+    uint64_t size;  // 0 if the texture is not stored
+};
+
+static_assert(sizeof(Vertex) == 8 * sizeof(float), "Vertex must stay tightly packed for the cooked cache");
+static_assert(sizeof(Meshlet) == 10 * sizeof(float), "Meshlet must stay tightly packed for the cooked cache");
+
+void append(std::vector<unsigned char>& out, const void* data, size_t size)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    out.insert(out.end(), p, p + size);
+}
+
+void appendString(std::vector<unsigned char>& out, const std::string& s)
+{
+    uint32_t len = static_cast<uint32_t>(s.size());
+    append(out, &len, sizeof(len));
+    append(out, s.data(), s.size());
+}
+
+// Keeps the vertex/index arrays 16-byte aligned inside the mapping.
+void alignTo16(std::vector<unsigned char>& out)
+{
+    while (out.size() % 16)
+        out.push_back(0);
+}
+
+bool readString(const unsigned char*& p, const unsigned char* end, std::string& s)
+{
+    uint32_t len;
+    if (end - p < (ptrdiff_t)sizeof(len))
+        return false;
+    std::memcpy(&len, p, sizeof(len));
+    p += sizeof(len);
+    if ((uint64_t)(end - p) < len)
+        return false;
+    s.assign(reinterpret_cast<const char*>(p), len);
+    p += len;
+    return true;
+}
+
+// Reads the texture strings and the LOD and meshlet tables that follow them.
+bool readMeshInfo(const unsigned char* base, size_t size, const MeshRecord& rec, std::vector<Texture>* textures,
+    std::vector<MeshLod>* lods, std::vector<Meshlet>* meshlets)
+{
+    if (rec.textureOffset > size)
+        return false;
+    const unsigned char* p = base + rec.textureOffset;
+    const unsigned char* end = base + size;
+    for (uint32_t i = 0; i < rec.textureCount; i++) {
+        Texture tex;
+        tex.id = 0;
+        if (!readString(p, end, tex.type) || !readString(p, end, tex.path))
+            return false;
+        if (textures)
+            textures->push_back(tex);
+    }
+    for (uint32_t i = 0; i < rec.lodCount; i++) {
+        MeshLod lod;
+        if (end - p < (ptrdiff_t)sizeof(lod))
+            return false;
+        std::memcpy(&lod, p, sizeof(lod));
+        p += sizeof(lod);
+        if ((uint64_t)lod.indexOffset + lod.indexCount > rec.indexCount)
+            return false;
+        if (lods)
+            lods->push_back(lod);
+    }
+    for (uint32_t i = 0; i < rec.meshletCount; i++) {
+        Meshlet meshlet;
+        if (end - p < (ptrdiff_t)sizeof(meshlet))
+            return false;
+        std::memcpy(&meshlet, p, sizeof(meshlet));
+        p += sizeof(meshlet);
+        if ((uint64_t)meshlet.indexOffset + meshlet.indexCount > rec.indexCount)
+            return false;
+        if (meshlets)
+            meshlets->push_back(meshlet);
+    }
+    return true;
+}
+
+}
+
+bool CookedModel::open(const std::string& path, uint64_t sourceHash)
+{
+    close();
+    file = std::make_shared<MappedFile>();
+    if (!file->open(path)) {
+        close();
+        return false;
+    }
+
+    const unsigned char* base = file->data();
+    size_t size = file->size();
+    CacheHeader header;
+    if (size < sizeof(header)) {
+        close();
+        return false;
+    }
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, CACHE_MAGIC, 4) != 0 || header.version != MESH_CACHE_VERSION ||
+        header.sourceHash != sourceHash || header.vertexSize != sizeof(Vertex) ||
+        size < sizeof(header) + (uint64_t)header.meshCount * sizeof(MeshRecord) + (uint64_t)header.imageCount * sizeof(ImageRecord)) {
+        close();
+        return false;
+    }
+
+    // Validate every record once so mesh() can trust the offsets.
+    const MeshRecord* records = reinterpret_cast<const MeshRecord*>(base + sizeof(header));
+    for (uint32_t i = 0; i < header.meshCount; i++) {
+        const MeshRecord& rec = records[i];
+        uint64_t vertexBytes = rec.vertexEncodedSize ? rec.vertexEncodedSize : (uint64_t)rec.vertexCount * sizeof(Vertex);
+        uint64_t indexBytes = rec.indexEncodedSize ? rec.indexEncodedSize : (uint64_t)rec.indexCount * sizeof(unsigned int);
+        bool ok = rec.vertexOffset % 16 == 0 && rec.indexOffset % 16 == 0 &&
+            rec.vertexOffset + vertexBytes <= size && rec.indexOffset + indexBytes <= size &&
+            readMeshInfo(base, size, rec, nullptr, nullptr, nullptr);
+        // Raw indices go to the GPU as they are, so an out-of-range one rejects the cache here;
+        // encoded ones are checked by mesh() after decoding.
+        const unsigned int* indices = reinterpret_cast<const unsigned int*>(base + rec.indexOffset);
+        for (uint32_t k = 0; ok && !rec.indexEncodedSize && k < rec.indexCount; k++)
+            ok = indices[k] < rec.vertexCount;
+        if (!ok) {
+            close();
+            return false;
+        }
+    }
+    const ImageRecord* images = reinterpret_cast<const ImageRecord*>(records + header.meshCount);
+    for (uint32_t i = 0; i < header.imageCount; i++) {
+        if (images[i].offset > size || images[i].size > size - images[i].offset) {
+            close();
+            return false;
+        }
+    }
+    meshCount = header.meshCount;
+    imageCount = header.imageCount;
+    return true;
+}
+
+EncodedImage CookedModel::image(size_t index) const
+{
+    const unsigned char* base = file->data();
+    const ImageRecord& rec = reinterpret_cast<const ImageRecord*>(base + sizeof(CacheHeader) + meshCount * sizeof(MeshRecord))[index];
+    EncodedImage image;
+    if (rec.size) {
+        // Shares ownership of the mapping, so the decode can finish after the model closes the cache.
+        image.data = std::shared_ptr<const unsigned char>(file, base + rec.offset);
+        image.size = rec.size;
+    }
+    return image;
+}
+
+CookedModel::MeshView CookedModel::mesh(size_t index) const
+{
+    const unsigned char* base = file->data();
+    const MeshRecord& rec = reinterpret_cast<const MeshRecord*>(base + sizeof(CacheHeader))[index];
+
+    MeshView view;
+    view.vertices = reinterpret_cast<const Vertex*>(base + rec.vertexOffset);
+    view.vertexCount = rec.vertexCount;
+    view.indices = reinterpret_cast<const unsigned int*>(base + rec.indexOffset);
+    view.indexCount = rec.indexCount;
+    if (rec.vertexEncodedSize) {
+        view.decodedVertices.resize(rec.vertexCount);
+        view.vertices = view.decodedVertices.data();
+    }
+    if (rec.indexEncodedSize) {
+        view.decodedIndices.resize(rec.indexCount);
+        view.indices = view.decodedIndices.data();
+    }
+    bool decoded =
+        (!rec.vertexEncodedSize || decodeVertexBuffer(view.decodedVertices.data(), rec.vertexCount, sizeof(Vertex),
+            base + rec.vertexOffset, rec.vertexEncodedSize)) &&
+        (!rec.indexEncodedSize || decodeIndexBuffer(view.decodedIndices.data(), rec.indexCount,
+            base + rec.indexOffset, rec.indexEncodedSize));
+    for (uint32_t i = 0; decoded && rec.indexEncodedSize && i < rec.indexCount; i++)
+        decoded = view.indices[i] < rec.vertexCount;
+    if (!decoded) {
+        std::cout << "ERROR::MESH_CACHE::DECODE_FAILED::mesh " << index << std::endl;
+        view.vertexCount = view.indexCount = 0;
+    }
+    view.aabbMin = glm::vec3(rec.aabbMin[0], rec.aabbMin[1], rec.aabbMin[2]);
+    view.aabbMax = glm::vec3(rec.aabbMax[0], rec.aabbMax[1], rec.aabbMax[2]);
+    readMeshInfo(base, file->size(), rec, &view.textures, &view.lods, &view.meshlets);
+    return view;
+}
+
+bool CookedModel::write(const std::string& path, uint64_t sourceHash, const std::vector<MeshData>& meshes,
+    const std::vector<EncodedImage>& images, bool compress)
+{
+    std::vector<unsigned char> out;
+    CacheHeader header;
+    std::memcpy(header.magic, CACHE_MAGIC, 4);
+    header.version = MESH_CACHE_VERSION;
+    header.sourceHash = sourceHash;
+    header.meshCount = static_cast<uint32_t>(meshes.size());
+    header.vertexSize = sizeof(Vertex);
+    header.imageCount = static_cast<uint32_t>(images.size());
+    header.padding = 0;
+    append(out, &header, sizeof(header));
+
+    std::vector<MeshRecord> records(meshes.size());
+    size_t recordsAt = out.size();
+    out.resize(out.size() + records.size() * sizeof(MeshRecord));
+    std::vector<ImageRecord> imageRecords(images.size());
+    size_t imageRecordsAt = out.size();
+    out.resize(out.size() + imageRecords.size() * sizeof(ImageRecord));
+
+    for (size_t i = 0; i < meshes.size(); i++) {
+        const MeshData& m = meshes[i];
+        MeshRecord& rec = records[i];
+        std::memset(&rec, 0, sizeof(rec));
+
+        rec.textureOffset = out.size();
+        rec.textureCount = static_cast<uint32_t>(m.textures.size());
+        for (const Texture& tex : m.textures) {
+            appendString(out, tex.type);
+            appendString(out, tex.path);
+        }
+        rec.lodCount = static_cast<uint32_t>(m.lods.size());
+        append(out, m.lods.data(), m.lods.size() * sizeof(MeshLod));
+        rec.meshletCount = static_cast<uint32_t>(m.meshlets.size());
+        append(out, m.meshlets.data(), m.meshlets.size() * sizeof(Meshlet));
+
+        alignTo16(out);
+        rec.vertexOffset = out.size();
+        rec.vertexCount = static_cast<uint32_t>(m.vertices.size());
+        if (compress) {
+            std::vector<unsigned char> encoded = encodeVertexBuffer(m.vertices.data(), m.vertices.size(), sizeof(Vertex));
+            rec.vertexEncodedSize = static_cast<uint32_t>(encoded.size());
+            append(out, encoded.data(), encoded.size());
+        }
+        else
+            append(out, m.vertices.data(), m.vertices.size() * sizeof(Vertex));
+
+        alignTo16(out);
+        rec.indexOffset = out.size();
+        rec.indexCount = static_cast<uint32_t>(m.indices.size());
+        std::vector<unsigned char> encoded;
+        if (compress)
+            encoded = encodeIndexBuffer(m.indices.data(), m.indices.size());
+        // Anything the codec refuses (not a triangle list) is stored raw.
+        rec.indexEncodedSize = static_cast<uint32_t>(encoded.size());
+        if (!encoded.empty())
+            append(out, encoded.data(), encoded.size());
+        else
+            append(out, m.indices.data(), m.indices.size() * sizeof(unsigned int));
+
+        for (int k = 0; k < 3; k++) {
+            rec.aabbMin[k] = m.aabbMin[k];
+            rec.aabbMax[k] = m.aabbMax[k];
+        }
+    }
+    if (!records.empty())
+        std::memcpy(&out[recordsAt], records.data(), records.size() * sizeof(MeshRecord));
+
+    for (size_t i = 0; i < images.size(); i++) {
+        alignTo16(out);
+        imageRecords[i].offset = out.size();
+        imageRecords[i].size = images[i].data ? images[i].size : 0;
+        append(out, images[i].data.get(), imageRecords[i].size);
+    }
+    if (!imageRecords.empty())
+        std::memcpy(&out[imageRecordsAt], imageRecords.data(), imageRecords.size() * sizeof(ImageRecord));
+
+    // Write next to the target and swap it in, so a crash never leaves a half-written cache.
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream f(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!f)
+            return false;
+        f.write(reinterpret_cast<const char*>(out.data()), out.size());
+        if (!f) {
+            f.close();
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+    }
+    std::remove(path.c_str());
+    return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
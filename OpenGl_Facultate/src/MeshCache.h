@@ -0,0 +1,56 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Mesh.h"
+#include "MappedFile.h"
+#include "TextureLoader.h"
+
+// Cooked, memory-mapped copy of a model's processed meshes and embedded textures, so later starts skip Assimp.
+// Bump MESH_CACHE_VERSION whenever the file layout, Vertex or the import steps change.
+const uint32_t MESH_CACHE_VERSION = 6;
+
+class CookedModel {
+public:
+    // A mesh as it sits in the mapped file; pointers stay valid while the CookedModel is open.
+    // Compressed meshes are decoded into the view's own arrays, which the pointers then refer to.
+    struct MeshView {
+        const Vertex* vertices;
+        uint32_t vertexCount;
+        const unsigned int* indices;
+        uint32_t indexCount;
+        glm::vec3 aabbMin, aabbMax;
+        std::vector<Texture> textures;
+        std::vector<MeshLod> lods;
+        std::vector<Meshlet> meshlets;
+        std::vector<Vertex> decodedVertices;
+        std::vector<unsigned int> decodedIndices;
+    };
+
+    // Maps the cache file, returns false if it is missing, corrupt, stale or from another version.
+    bool open(const std::string& path, uint64_t sourceHash);
+    void close() { file.reset(); meshCount = 0; imageCount = 0; }
+
+    size_t size() const { return meshCount; }
+    MeshView mesh(size_t index) const;
+
+    // Embedded texture "*index" as the model file stored it, empty if it wasn't a compressed image.
+    // Points into the mapping and keeps it alive, also after close().
+    size_t images() const { return imageCount; }
+    EncodedImage image(size_t index) const;
+
+    // Writes the processed meshes and embedded textures of a model, tagged with the hash of its source file.
+    // compress stores vertices and indices through MeshCodec instead of raw.
+    static bool write(const std::string& path, uint64_t sourceHash, const std::vector<MeshData>& meshes,
+        const std::vector<EncodedImage>& images, bool compress = false);
+
+private:
+    std::shared_ptr<MappedFile> file;
+    size_t meshCount = 0;
+    size_t imageCount = 0;
+};
+
+#endif
@@ -0,0 +1,413 @@
+#include "MeshCodec.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if !defined(MESH_CODEC_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define MESH_CODEC_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const unsigned char VERTEX_CODEC_VERSION = 0xA1;
+const unsigned char INDEX_CODEC_VERSION = 0xB1;
+
+const size_t VERTEX_BLOCK = 256;
+const size_t GROUP = 16;
+// Bytes a group of 16 takes in each of the four modes.
+const size_t MODE_BYTES[4] = { 0, 4, 8, 16 };
+
+uint32_t zigzag(uint32_t v) { return (v << 1) ^ (uint32_t)((int32_t)v >> 31); }
+uint32_t unzigzag(uint32_t v) { return (v >> 1) ^ (0u - (v & 1)); }
+
+// ── vertex streams ───────────────────────────────────────────────────────
+
+void encodeGroup(const unsigned char* values, int mode, std::vector<unsigned char>& out)
+{
+    if (mode == 1) {
+        for (size_t j = 0; j < 4; j++)
+            out.push_back((unsigned char)(values[j * 4] << 6 | values[j * 4 + 1] << 4 | values[j * 4 + 2] << 2 | values[j * 4 + 3]));
+    }
+    else if (mode == 2) {
+        for (size_t j = 0; j < 8; j++)
+            out.push_back((unsigned char)(values[j * 2] << 4 | values[j * 2 + 1]));
+    }
+    else if (mode == 3) {
+        out.insert(out.end(), values, values + GROUP);
+    }
+}
+
+// Header of 2-bit modes, then the groups; stream holds a multiple of 16 bytes.
+void encodeStream(const unsigned char* stream, size_t groups, std::vector<unsigned char>& out)
+{
+    size_t headerAt = out.size();
+    out.resize(out.size() + (groups + 3) / 4, 0);
+    for (size_t g = 0; g < groups; g++) {
+        const unsigned char* values = stream + g * GROUP;
+        unsigned char largest = *std::max_element(values, values + GROUP);
+        int mode = largest == 0 ? 0 : largest < 4 ? 1 : largest < 16 ? 2 : 3;
+        out[headerAt + g / 4] |= (unsigned char)(mode << ((g % 4) * 2));
+        encodeGroup(values, mode, out);
+    }
+}
+
+#ifdef MESH_CODEC_SSE2
+
+inline __m128i loadBytes4(const unsigned char* p)
+{
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return _mm_cvtsi32_si128((int)v);
+}
+
+// Splits each byte of the low half into its high and low nibble, high first.
+inline __m128i expandNibbles(__m128i x)
+{
+    __m128i mask = _mm_set1_epi8(0x0f);
+    return _mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(x, 4), mask), _mm_and_si128(x, mask));
+}
+
+inline __m128i expandCrumbs(__m128i x)
+{
+    __m128i mask = _mm_set1_epi8(0x03);
+    return _mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(x, 2), mask), _mm_and_si128(x, mask));
+}
+
+inline void decodeGroup(const unsigned char* src, int mode, unsigned char* dst)
+{
+    __m128i v;
+    switch (mode) {
+    case 0: v = _mm_setzero_si128(); break;
+    case 1: v = expandCrumbs(expandNibbles(loadBytes4(src))); break;
+    case 2: v = expandNibbles(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src))); break;
+    default: v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)); break;
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), v);
+}
+
+#else
+
+inline void decodeGroup(const unsigned char* src, int mode, unsigned char* dst)
+{
+    switch (mode) {
+    case 0:
+        std::memset(dst, 0, GROUP);
+        break;
+    case 1:
+        for (size_t j = 0; j < 16; j++)
+            dst[j] = (src[j / 4] >> (6 - (j % 4) * 2)) & 3;
+        break;
+    case 2:
+        for (size_t j = 0; j < 16; j++)
+            dst[j] = (src[j / 2] >> (j % 2 ? 0 : 4)) & 15;
+        break;
+    default:
+        std::memcpy(dst, src, GROUP);
+        break;
+    }
+}
+
+#endif
+
+const unsigned char* decodeStream(const unsigned char* p, const unsigned char* end, size_t groups, unsigned char* stream)
+{
+    const unsigned char* header = p;
+    p += (groups + 3) / 4;
+    if (p > end)
+        return nullptr;
+    for (size_t g = 0; g < groups; g++) {
+        int mode = (header[g / 4] >> ((g % 4) * 2)) & 3;
+        // The SSE2 loads read whole words, so check against the widest read, not just the payload.
+        if ((size_t)(end - p) < MODE_BYTES[mode])
+            return nullptr;
+        decodeGroup(p, mode, stream + g * GROUP);
+        p += MODE_BYTES[mode];
+    }
+    return p;
+}
+
+// Rebuilds one 32-bit channel of n vertices from its four byte streams, carrying the running value.
+void reconstructChannel(const unsigned char* const bytes[4], size_t n, unsigned char* dst, size_t stride, uint32_t& last)
+{
+    size_t i = 0;
+#ifdef MESH_CODEC_SSE2
+    __m128i running = _mm_set1_epi32((int)last);
+    __m128i one = _mm_set1_epi32(1);
+    for (; i + GROUP <= n; i += GROUP) {
+        __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes[0] + i));
+        __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes[1] + i));
+        __m128i b2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes[2] + i));
+        __m128i b3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes[3] + i));
+        // Byte transpose back to 16 little-endian words.
+        __m128i lo01 = _mm_unpacklo_epi8(b0, b1), hi01 = _mm_unpackhi_epi8(b0, b1);
+        __m128i lo23 = _mm_unpacklo_epi8(b2, b3), hi23 = _mm_unpackhi_epi8(b2, b3);
+        __m128i words[4] = { _mm_unpacklo_epi16(lo01, lo23), _mm_unpackhi_epi16(lo01, lo23),
+            _mm_unpacklo_epi16(hi01, hi23), _mm_unpackhi_epi16(hi01, hi23) };
+        for (int q = 0; q < 4; q++) {
+            __m128i w = words[q];
+            w = _mm_xor_si128(_mm_srli_epi32(w, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(w, one)));
+            // Prefix sum across the four lanes, then add what came before.
+            w = _mm_add_epi32(w, _mm_slli_si128(w, 4));
+            w = _mm_add_epi32(w, _mm_slli_si128(w, 8));
+            w = _mm_add_epi32(w, running);
+            running = _mm_shuffle_epi32(w, _MM_SHUFFLE(3, 3, 3, 3));
+            unsigned char* out = dst + (i + q * 4) * stride;
+            for (int lane = 0; lane < 4; lane++) {
+                uint32_t value = (uint32_t)_mm_cvtsi128_si32(w);
+                std::memcpy(out + lane * stride, &value, 4);
+                w = _mm_srli_si128(w, 4);
+            }
+        }
+    }
+    last = (uint32_t)_mm_cvtsi128_si32(running);
+#endif
+    for (; i < n; i++) {
+        uint32_t v = bytes[0][i] | bytes[1][i] << 8 | bytes[2][i] << 16 | (uint32_t)bytes[3][i] << 24;
+        last += unzigzag(v);
+        std::memcpy(dst + i * stride, &last, 4);
+    }
+}
+
+// ── index coding ─────────────────────────────────────────────────────────
+
+const int EDGE_FIFO = 15;
+const int VERTEX_FIFO = 14;
+const int VERTEX_NEXT = 0;       // the next never-seen index
+const int VERTEX_EXPLICIT = 15;  // varint follows
+const int NO_EDGE = 15;
+
+struct IndexState {
+    unsigned int edges[EDGE_FIFO][2];
+    unsigned int vertices[VERTEX_FIFO];
+    int edgeHead = 0, vertexHead = 0;
+    unsigned int next = 0;
+
+    IndexState() {
+        std::memset(edges, 0xff, sizeof(edges));
+        std::memset(vertices, 0xff, sizeof(vertices));
+    }
+    void pushEdge(unsigned int a, unsigned int b) {
+        edges[edgeHead][0] = a;
+        edges[edgeHead][1] = b;
+        edgeHead = (edgeHead + 1) % EDGE_FIFO;
+    }
+    void pushVertex(unsigned int v) {
+        vertices[vertexHead] = v;
+        vertexHead = (vertexHead + 1) % VERTEX_FIFO;
+    }
+    // Slot i counts back from the most recent entry.
+    const unsigned int* edge(int i) const { return edges[(edgeHead + EDGE_FIFO - 1 - i) % EDGE_FIFO]; }
+    unsigned int vertex(int i) const { return vertices[(vertexHead + VERTEX_FIFO - 1 - i) % VERTEX_FIFO]; }
+
+    int findEdge(unsigned int a, unsigned int b) const {
+        for (int i = 0; i < EDGE_FIFO; i++)
+            if (edge(i)[0] == a && edge(i)[1] == b)
+                return i;
+        return -1;
+    }
+    int findVertex(unsigned int v) const {
+        for (int i = 0; i < VERTEX_FIFO; i++)
+            if (vertex(i) == v)
+                return i;
+        return -1;
+    }
+    // Both sides call this once a vertex is known, in the same order.
+    void seen(unsigned int v, int code) {
+        if (code != VERTEX_EXPLICIT && code != VERTEX_NEXT)
+            return;
+        pushVertex(v);
+        next = std::max(next, v + 1);
+    }
+    // Neighbours walk a shared edge the other way round, so edges are stored reversed.
+    void addTriangle(unsigned int a, unsigned int b, unsigned int c, bool sharedFirstEdge) {
+        if (!sharedFirstEdge)
+            pushEdge(b, a);
+        pushEdge(c, b);
+        pushEdge(a, c);
+    }
+};
+
+void writeVarint(std::vector<unsigned char>& out, uint32_t v)
+{
+    while (v >= 0x80) {
+        out.push_back((unsigned char)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((unsigned char)v);
+}
+
+bool readVarint(const unsigned char*& p, const unsigned char* end, uint32_t& v)
+{
+    v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (p == end)
+            return false;
+        unsigned char byte = *p++;
+        v |= (uint32_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+// Picks the code for v and updates the state; explicit values are appended to extra.
+int encodeVertex(IndexState& s, unsigned int v, std::vector<unsigned char>& extra)
+{
+    int code;
+    if (v == s.next)
+        code = VERTEX_NEXT;
+    else {
+        int slot = s.findVertex(v);
+        if (slot >= 0)
+            code = slot + 1;
+        else {
+            code = VERTEX_EXPLICIT;
+            writeVarint(extra, zigzag(v - s.next));
+        }
+    }
+    s.seen(v, code);
+    return code;
+}
+
+bool decodeVertex(IndexState& s, int code, const unsigned char*& p, const unsigned char* end, unsigned int& v)
+{
+    if (code == VERTEX_NEXT)
+        v = s.next;
+    else if (code == VERTEX_EXPLICIT) {
+        uint32_t delta;
+        if (!readVarint(p, end, delta))
+            return false;
+        v = s.next + unzigzag(delta);
+    }
+    else
+        v = s.vertex(code - 1);
+    s.seen(v, code);
+    return true;
+}
+
+}
+
+std::vector<unsigned char> encodeVertexBuffer(const void* vertices, size_t count, size_t stride)
+{
+    std::vector<unsigned char> out;
+    out.push_back(VERTEX_CODEC_VERSION);
+    const unsigned char* src = static_cast<const unsigned char*>(vertices);
+    size_t channels = stride / 4;
+    std::vector<uint32_t> last(channels, 0);
+    std::vector<unsigned char> streams(4 * VERTEX_BLOCK);
+
+    for (size_t first = 0; first < count; first += VERTEX_BLOCK) {
+        size_t n = std::min(VERTEX_BLOCK, count - first);
+        size_t groups = (n + GROUP - 1) / GROUP;
+        for (size_t c = 0; c < channels; c++) {
+            std::fill(streams.begin(), streams.end(), 0);
+            for (size_t i = 0; i < n; i++) {
+                uint32_t value;
+                std::memcpy(&value, src + (first + i) * stride + c * 4, 4);
+                uint32_t delta = zigzag(value - last[c]);
+                last[c] = value;
+                for (int k = 0; k < 4; k++)
+                    streams[k * VERTEX_BLOCK + i] = (unsigned char)(delta >> (k * 8));
+            }
+            for (int k = 0; k < 4; k++)
+                encodeStream(&streams[k * VERTEX_BLOCK], groups, out);
+        }
+    }
+    return out;
+}
+
+bool decodeVertexBuffer(void* vertices, size_t count, size_t stride, const unsigned char* data, size_t size)
+{
+    if (stride % 4 || size < 1 || data[0] != VERTEX_CODEC_VERSION)
+        return false;
+    const unsigned char* p = data + 1;
+    const unsigned char* end = data + size;
+    unsigned char* dst = static_cast<unsigned char*>(vertices);
+    size_t channels = stride / 4;
+    std::vector<uint32_t> last(channels, 0);
+    unsigned char streams[4][VERTEX_BLOCK];
+
+    for (size_t first = 0; first < count; first += VERTEX_BLOCK) {
+        size_t n = std::min(VERTEX_BLOCK, count - first);
+        size_t groups = (n + GROUP - 1) / GROUP;
+        for (size_t c = 0; c < channels; c++) {
+            for (int k = 0; k < 4; k++)
+                if (!(p = decodeStream(p, end, groups, streams[k])))
+                    return false;
+            const unsigned char* bytes[4] = { streams[0], streams[1], streams[2], streams[3] };
+            reconstructChannel(bytes, n, dst + first * stride + c * 4, stride, last[c]);
+        }
+    }
+    return p == end;
+}
+
+std::vector<unsigned char> encodeIndexBuffer(const unsigned int* indices, size_t count)
+{
+    std::vector<unsigned char> out, extra;
+    if (count % 3)
+        return out;
+    out.push_back(INDEX_CODEC_VERSION);
+    IndexState s;
+    for (size_t i = 0; i < count; i += 3) {
+        unsigned int t[3] = { indices[i], indices[i + 1], indices[i + 2] };
+        extra.clear();
+
+        // Rotate a shared edge to the front; the winding stays the same.
+        int slot = -1;
+        for (int r = 0; r < 3 && slot < 0; r++) {
+            slot = s.findEdge(t[r], t[(r + 1) % 3]);
+            if (slot >= 0 && r > 0) {
+                unsigned int rotated[3] = { t[r], t[(r + 1) % 3], t[(r + 2) % 3] };
+                std::memcpy(t, rotated, sizeof(t));
+            }
+        }
+
+        if (slot >= 0) {
+            int code = encodeVertex(s, t[2], extra);
+            out.push_back((unsigned char)(slot << 4 | code));
+        }
+        else {
+            int a = encodeVertex(s, t[0], extra);
+            int b = encodeVertex(s, t[1], extra);
+            int c = encodeVertex(s, t[2], extra);
+            out.push_back((unsigned char)(NO_EDGE << 4 | a));
+            out.push_back((unsigned char)(b << 4 | c));
+        }
+        out.insert(out.end(), extra.begin(), extra.end());
+        s.addTriangle(t[0], t[1], t[2], slot >= 0);
+    }
+    return out;
+}
+
+bool decodeIndexBuffer(unsigned int* indices, size_t count, const unsigned char* data, size_t size)
+{
+    if (count % 3 || size < 1 || data[0] != INDEX_CODEC_VERSION)
+        return false;
+    const unsigned char* p = data + 1;
+    const unsigned char* end = data + size;
+    IndexState s;
+    for (size_t i = 0; i < count; i += 3) {
+        if (p == end)
+            return false;
+        unsigned char code = *p++;
+        unsigned int* t = indices + i;
+        int slot = code >> 4;
+        if (slot != NO_EDGE) {
+            t[0] = s.edge(slot)[0];
+            t[1] = s.edge(slot)[1];
+            if (!decodeVertex(s, code & 15, p, end, t[2]))
+                return false;
+        }
+        else {
+            if (p == end)
+                return false;
+            unsigned char codes = *p++;
+            if (!decodeVertex(s, code & 15, p, end, t[0]) || !decodeVertex(s, codes >> 4, p, end, t[1]) ||
+                !decodeVertex(s, codes & 15, p, end, t[2]))
+                return false;
+        }
+        s.addTriangle(t[0], t[1], t[2], slot != NO_EDGE);
+    }
+    return p == end;
+}
@@ -0,0 +1,28 @@
+#ifndef MESH_CODEC_H
+#define MESH_CODEC_H
+
+#include <cstddef>
+#include <vector>
+
+// Lossless compression of vertex and index buffers for the cooked cache, decoded on load.
+//
+// Vertices: each 32-bit channel is delta-coded against the previous vertex (integer difference of the
+// bit patterns, zigzagged), and the four bytes of the deltas go to separate streams. In blocks of 256
+// vertices every stream is cut into groups of 16 bytes stored at 0, 2, 4 or 8 bits each, so the high
+// bytes of slowly changing channels take almost nothing. Works best after optimizeVertexFetch.
+//
+// Indices: triangles are coded against a FIFO of recent edges and vertices. A triangle that shares an
+// edge with a recent one (the common case after optimizeVertexCache) costs one byte; its winding is kept
+// but it may come back rotated.
+//
+// Decoding uses SSE2 where available. No GL; safe on worker threads.
+
+// stride must be a multiple of 4.
+std::vector<unsigned char> encodeVertexBuffer(const void* vertices, size_t count, size_t stride);
+bool decodeVertexBuffer(void* vertices, size_t count, size_t stride, const unsigned char* data, size_t size);
+
+// Triangle lists only: returns an empty buffer when count is not a multiple of 3.
+std::vector<unsigned char> encodeIndexBuffer(const unsigned int* indices, size_t count);
+bool decodeIndexBuffer(unsigned int* indices, size_t count, const unsigned char* data, size_t size);
+
+#endif
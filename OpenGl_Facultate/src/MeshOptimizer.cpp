@@ -0,0 +1,642 @@
+#include "MeshOptimizer.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
+namespace {
+
+const uint32_t UNUSED = 0xffffffffu;
+
+// The 8 floats of a vertex as compared by weldVertices: raw bits, or grid cells when welding with an epsilon.
+struct WeldKey {
+    uint32_t words[8];
+
+    WeldKey(const Vertex& v, float epsilon) {
+        const float values[8] = { v.Position.x, v.Position.y, v.Position.z, v.Normal.x, v.Normal.y, v.Normal.z,
+            v.TexCoords.x, v.TexCoords.y };
+        for (int i = 0; i < 8; i++) {
+            if (epsilon > 0.0f)
+                words[i] = (uint32_t)(int32_t)std::floor(values[i] / epsilon + 0.5f);
+            else {
+                // -0 and +0 are the same vertex
+                float value = values[i] == 0.0f ? 0.0f : values[i];
+                std::memcpy(&words[i], &value, sizeof(value));
+            }
+        }
+    }
+    bool operator==(const WeldKey& other) const { return std::memcmp(words, other.words, sizeof(words)) == 0; }
+    uint32_t hash() const {
+        // Murmur-style mixing of each word, cheap enough to run once per vertex.
+        uint32_t h = 0;
+        for (uint32_t w : words) {
+            w *= 0xcc9e2d51u;
+            w = (w << 15) | (w >> 17);
+            h ^= w * 0x1b873593u;
+            h = ((h << 13) | (h >> 19)) * 5 + 0xe6546b64u;
+        }
+        h ^= h >> 16;
+        h *= 0x85ebca6bu;
+        h ^= h >> 13;
+        return h;
+    }
+};
+
+// Forsyth's scoring: the three most recent vertices score a flat 0.75, older ones decay with their
+// position, and vertices with few triangles left get a boost so they are finished off early.
+const int FORSYTH_CACHE_SIZE = 32;
+
+float forsythVertexScore(int cachePosition, unsigned int remaining)
+{
+    // Both terms only depend on small integers, so they are tabulated once.
+    static const struct Tables {
+        float cache[FORSYTH_CACHE_SIZE];
+        float valence[FORSYTH_CACHE_SIZE];
+        Tables() {
+            for (int i = 0; i < FORSYTH_CACHE_SIZE; i++) {
+                cache[i] = i < 3 ? 0.75f : std::pow(1.0f - (i - 3) / float(FORSYTH_CACHE_SIZE - 3), 1.5f);
+                valence[i] = i > 0 ? 2.0f / std::sqrt((float)i) : 0.0f;
+            }
+        }
+    } tables;
+
+    if (remaining == 0)
+        return -1.0f;
+    float score = cachePosition >= 0 ? tables.cache[cachePosition] : 0.0f;
+    return score + (remaining < (unsigned int)FORSYTH_CACHE_SIZE ? tables.valence[remaining] : 2.0f / std::sqrt((float)remaining));
+}
+
+// Symmetric 4x4 error quadric of area-weighted planes, upper triangle only.
+struct Quadric {
+    double xx = 0, xy = 0, xz = 0, xw = 0, yy = 0, yz = 0, yw = 0, zz = 0, zw = 0, ww = 0;
+    double weight = 0;
+
+    void addPlane(const glm::dvec3& n, double d, double w) {
+        xx += w * n.x * n.x; xy += w * n.x * n.y; xz += w * n.x * n.z; xw += w * n.x * d;
+        yy += w * n.y * n.y; yz += w * n.y * n.z; yw += w * n.y * d;
+        zz += w * n.z * n.z; zw += w * n.z * d;
+        ww += w * d * d;
+        weight += w;
+    }
+    void add(const Quadric& q) {
+        xx += q.xx; xy += q.xy; xz += q.xz; xw += q.xw; yy += q.yy; yz += q.yz; yw += q.yw;
+        zz += q.zz; zw += q.zw; ww += q.ww; weight += q.weight;
+    }
+    // Weighted mean squared distance of p to the planes.
+    double error(const glm::vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double e = xx * x * x + 2 * xy * x * y + 2 * xz * x * z + 2 * xw * x
+            + yy * y * y + 2 * yz * y * z + 2 * yw * y
+            + zz * z * z + 2 * zw * z + ww;
+        return weight > 0 ? std::max(e, 0.0) / weight : 0.0;
+    }
+};
+
+struct PositionKey {
+    uint32_t bits[3];
+    bool operator==(const PositionKey& o) const { return std::memcmp(bits, o.bits, sizeof(bits)) == 0; }
+};
+
+struct PositionKeyHash {
+    size_t operator()(const PositionKey& k) const {
+        return (size_t)hashBytes(k.bits, sizeof(k.bits));
+    }
+};
+
+PositionKey positionKey(const glm::vec3& p)
+{
+    PositionKey k;
+    std::memcpy(k.bits, &p[0], sizeof(k.bits));
+    return k;
+}
+
+// Triangles drawn between two full cache misses in the cache-optimized order; overdraw sorting moves these as units.
+const size_t MIN_CLUSTER_TRIANGLES = 64;
+
+void computeBounds(MeshPart& part)
+{
+    if (part.vertices.empty())
+        return;
+    part.aabbMin = part.aabbMax = part.vertices[0].Position;
+    for (const Vertex& v : part.vertices) {
+        part.aabbMin = glm::min(part.aabbMin, v.Position);
+        part.aabbMax = glm::max(part.aabbMax, v.Position);
+    }
+}
+
+}
+
+std::vector<MeshPart> splitForShortIndices(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+    size_t maxVertices)
+{
+    std::vector<MeshPart> parts(1);
+    // remap[v] is v's index in the current part; only the entries it touched are reset between parts.
+    std::vector<uint32_t> remap(vertices.size(), UNUSED);
+    std::vector<unsigned int> touched;
+
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        int fresh = 0;
+        for (int k = 0; k < 3; k++)
+            fresh += remap[indices[t + k]] == UNUSED ? 1 : 0;
+        if (parts.back().vertices.size() + fresh > maxVertices) {
+            for (unsigned int v : touched)
+                remap[v] = UNUSED;
+            touched.clear();
+            parts.emplace_back();
+        }
+
+        MeshPart& part = parts.back();
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = indices[t + k];
+            if (remap[v] == UNUSED) {
+                remap[v] = (uint32_t)part.vertices.size();
+                part.vertices.push_back(vertices[v]);
+                touched.push_back(v);
+            }
+            part.indices.push_back(remap[v]);
+        }
+    }
+
+    for (MeshPart& part : parts)
+        computeBounds(part);
+    return parts;
+}
+
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, int cacheSize)
+{
+    VertexCacheStats stats;
+    if (indices.size() < 3)
+        return stats;
+    // timestamps[v] is when v entered the cache; it is still cached while fewer than cacheSize misses followed.
+    std::vector<size_t> timestamps(vertexCount, 0);
+    std::vector<char> referenced(vertexCount, 0);
+    size_t misses = 0, used = 0;
+    for (unsigned int v : indices) {
+        if (!referenced[v]) {
+            referenced[v] = 1;
+            used++;
+        }
+        if (timestamps[v] == 0 || misses + 1 - timestamps[v] > (size_t)cacheSize) {
+            misses++;
+            timestamps[v] = misses;
+        }
+    }
+    stats.acmr = (float)misses / (indices.size() / 3);
+    stats.atvr = (float)misses / used;
+    return stats;
+}
+
+void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // Triangles around each vertex, in one flat array; the live ones are kept in front of each range.
+    std::vector<unsigned int> remaining(vertexCount, 0), offsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        remaining[indices[i]]++;
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+    std::vector<unsigned int> adjacency(triangleCount * 3), fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int k = 0; k < 3; k++)
+            adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        vertexScore[v] = forsythVertexScore(-1, remaining[v]);
+    std::vector<float> triangleScore(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+        triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+    std::vector<char> emitted(triangleCount, 0);
+    std::vector<unsigned int> out, cache, nextCache;
+    out.reserve(triangleCount * 3);
+    size_t cursor = 0;
+    long best = -1;
+    for (size_t n = 0; n < triangleCount; n++) {
+        if (best < 0) {
+            // Nothing left around the cache: continue with the next triangle in input order.
+            while (emitted[cursor])
+                cursor++;
+            best = (long)cursor;
+        }
+
+        const unsigned int* tri = &indices[best * 3];
+        emitted[best] = 1;
+        nextCache.assign(tri, tri + 3);
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = tri[k];
+            out.push_back(v);
+            // Drop the triangle from v's live range.
+            unsigned int* begin = &adjacency[offsets[v]];
+            unsigned int* end = begin + remaining[v];
+            *std::find(begin, end, (unsigned int)best) = *(end - 1);
+            remaining[v]--;
+        }
+        for (unsigned int v : cache)
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                nextCache.push_back(v);
+
+        // Rescore everything that moved, then the live triangles around it.
+        for (size_t i = 0; i < nextCache.size(); i++) {
+            unsigned int v = nextCache[i];
+            cachePosition[v] = i < (size_t)FORSYTH_CACHE_SIZE ? (int)i : -1;
+            vertexScore[v] = forsythVertexScore(cachePosition[v], remaining[v]);
+        }
+        best = -1;
+        float bestScore = -1.0f;
+        for (unsigned int v : nextCache) {
+            for (unsigned int a = 0; a < remaining[v]; a++) {
+                unsigned int t = adjacency[offsets[v] + a];
+                const unsigned int* tv = &indices[t * 3];
+                triangleScore[t] = vertexScore[tv[0]] + vertexScore[tv[1]] + vertexScore[tv[2]];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = (long)t;
+                }
+            }
+        }
+        if (nextCache.size() > (size_t)FORSYTH_CACHE_SIZE)
+            nextCache.resize(FORSYTH_CACHE_SIZE);
+        cache.swap(nextCache);
+    }
+    indices.swap(out);
+}
+
+void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < MIN_CLUSTER_TRIANGLES * 2)
+        return;
+    VertexCacheStats original = analyzeVertexCache(indices, vertices.size());
+
+    // Cluster boundaries where the cache restarts (all three vertices miss), at least MIN_CLUSTER_TRIANGLES apart.
+    std::vector<size_t> clusterStart(1, 0);
+    std::vector<size_t> timestamps(vertices.size(), 0);
+    size_t misses = 0;
+    for (size_t t = 0; t < triangleCount; t++) {
+        int triangleMisses = 0;
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = indices[t * 3 + k];
+            if (timestamps[v] == 0 || misses + 1 - timestamps[v] > 16) {
+                misses++;
+                timestamps[v] = misses;
+                triangleMisses++;
+            }
+        }
+        if (triangleMisses == 3 && t - clusterStart.back() >= MIN_CLUSTER_TRIANGLES)
+            clusterStart.push_back(t);
+    }
+    clusterStart.push_back(triangleCount);
+    size_t clusterCount = clusterStart.size() - 1;
+    if (clusterCount < 2)
+        return;
+
+    // Sort key: how far the cluster sits out along its own average normal, from the mesh centroid.
+    glm::vec3 meshCentroid(0.0f);
+    for (const Vertex& v : vertices)
+        meshCentroid += v.Position;
+    meshCentroid /= (float)std::max<size_t>(vertices.size(), 1);
+
+    std::vector<float> keys(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++) {
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; t++) {
+            const glm::vec3& a = vertices[indices[t * 3]].Position;
+            const glm::vec3& b = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3& d = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 n = glm::cross(b - a, d - a);  // length is twice the area
+            float w = glm::length(n);
+            centroid += (a + b + d) * (w / 3.0f);
+            normal += n;
+            area += w;
+        }
+        centroid = area > 0.0f ? centroid / area : vertices[indices[clusterStart[c] * 3]].Position;
+        float length = glm::length(normal);
+        keys[c] = length > 0.0f ? glm::dot(centroid - meshCentroid, normal / length) : 0.0f;
+    }
+
+    std::vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+        order[c] = c;
+    std::stable_sort(order.begin(), order.end(), [&keys](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+    std::vector<unsigned int> sorted;
+    sorted.reserve(indices.size());
+    for (size_t c : order)
+        sorted.insert(sorted.end(), indices.begin() + clusterStart[c] * 3, indices.begin() + clusterStart[c + 1] * 3);
+
+    if (analyzeVertexCache(sorted, vertices.size()).acmr <= original.acmr * threshold)
+        indices.swap(sorted);
+}
+
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+    std::vector<uint32_t> remap(vertices.size(), UNUSED);
+    std::vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+    for (unsigned int& index : indices) {
+        if (remap[index] == UNUSED) {
+            remap[index] = (uint32_t)ordered.size();
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(ordered);
+}
+
+void optimizeMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+    VertexCacheStats& before, VertexCacheStats& after)
+{
+    before = analyzeVertexCache(indices, vertices.size());
+    optimizeVertexCache(indices, vertices.size());
+    optimizeOverdraw(indices, vertices);
+    optimizeVertexFetch(vertices, indices);
+    after = analyzeVertexCache(indices, vertices.size());
+}
+
+std::vector<unsigned int> simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+    size_t targetIndexCount, float& error)
+{
+    error = 0.0f;
+    size_t n = vertices.size();
+
+    // Corners sharing a position are one point of the surface; the first vertex at a position stands for all.
+    std::vector<unsigned int> canonical(n);
+    std::unordered_map<PositionKey, unsigned int, PositionKeyHash> byPosition;
+    byPosition.reserve(n);
+    for (size_t v = 0; v < n; v++)
+        canonical[v] = byPosition.emplace(positionKey(vertices[v].Position), (unsigned int)v).first->second;
+
+    // Seams: a point with several normals or UVs. Moving it would tear the attributes apart.
+    std::vector<char> seam(n, 0), locked(n, 0);
+    for (size_t v = 0; v < n; v++) {
+        const Vertex& c = vertices[canonical[v]];
+        if (c.Normal != vertices[v].Normal || c.TexCoords != vertices[v].TexCoords)
+            seam[canonical[v]] = 1;
+    }
+    // Borders: edges with a single triangle. Their points stay put so open outlines keep their shape.
+    std::unordered_map<uint64_t, int> edgeUse;
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        for (int k = 0; k < 3; k++) {
+            uint64_t a = canonical[indices[t + k]], b = canonical[indices[t + (k + 1) % 3]];
+            edgeUse[a < b ? (a << 32 | b) : (b << 32 | a)]++;
+        }
+    }
+    for (const auto& e : edgeUse) {
+        if (e.second == 1) {
+            locked[e.first >> 32] = 1;
+            locked[e.first & 0xffffffffu] = 1;
+        }
+    }
+
+    std::vector<Quadric> quadrics(n);
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        glm::dvec3 a(vertices[indices[t]].Position), b(vertices[indices[t + 1]].Position), c(vertices[indices[t + 2]].Position);
+        glm::dvec3 normal = glm::cross(b - a, c - a);
+        double area = glm::length(normal);
+        if (area <= 0.0)
+            continue;
+        normal /= area;
+        for (int k = 0; k < 3; k++)
+            quadrics[canonical[indices[t + k]]].addPlane(normal, -glm::dot(normal, a), area * 0.5);
+    }
+
+    std::vector<unsigned int> current(indices.begin(), indices.begin() + indices.size() / 3 * 3);
+    std::vector<unsigned int> collapseTo(n);
+    std::vector<char> touched(n);
+    struct Candidate {
+        double cost;
+        unsigned int from, to;  // canonical point that moves, vertex it moves onto
+    };
+    std::vector<Candidate> candidates;
+    std::vector<unsigned int> triangleOffsets, triangleList;
+
+    while (current.size() > targetIndexCount) {
+        size_t triangleCount = current.size() / 3;
+
+        // Triangles around each canonical point.
+        triangleOffsets.assign(n + 1, 0);
+        for (unsigned int v : current)
+            triangleOffsets[canonical[v] + 1]++;
+        for (size_t v = 0; v < n; v++)
+            triangleOffsets[v + 1] += triangleOffsets[v];
+        triangleList.resize(current.size());
+        std::vector<unsigned int> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+        for (size_t i = 0; i < current.size(); i++)
+            triangleList[fill[canonical[current[i]]]++] = (unsigned int)(i / 3);
+
+        candidates.clear();
+        for (size_t i = 0; i < current.size(); i++) {
+            unsigned int from = canonical[current[i]];
+            unsigned int to = current[i - i % 3 + (i + 1) % 3];
+            unsigned int target = canonical[to];
+            if (locked[from] || seam[from] || seam[target] || from == target)
+                continue;
+            Quadric q = quadrics[from];
+            q.add(quadrics[target]);
+            candidates.push_back(Candidate{ q.error(vertices[to].Position), from, to });
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+            return a.cost != b.cost ? a.cost < b.cost : a.from != b.from ? a.from < b.from : a.to < b.to;
+        });
+
+        // Cheapest first, each point involved in at most one collapse per pass so the checks below stay valid.
+        std::fill(touched.begin(), touched.end(), 0);
+        for (size_t v = 0; v < n; v++)
+            collapseTo[v] = (unsigned int)v;
+        size_t removed = 0, wanted = triangleCount - targetIndexCount / 3;
+        for (const Candidate& c : candidates) {
+            if (removed >= wanted)
+                break;
+            unsigned int target = canonical[c.to];
+            if (touched[c.from] || touched[target])
+                continue;
+
+            // Reject collapses that flip or flatten a surviving triangle around the moving point.
+            bool flips = false;
+            size_t shared = 0;
+            const glm::vec3& destination = vertices[c.to].Position;
+            for (unsigned int a = triangleOffsets[c.from]; a < triangleOffsets[c.from + 1] && !flips; a++) {
+                const unsigned int* tri = &current[triangleList[a] * 3];
+                glm::vec3 p[3], q[3];
+                bool hasTarget = false;
+                for (int k = 0; k < 3; k++) {
+                    p[k] = q[k] = vertices[tri[k]].Position;
+                    if (canonical[tri[k]] == c.from)
+                        q[k] = destination;
+                    hasTarget |= canonical[tri[k]] == target;
+                }
+                if (hasTarget) {
+                    shared++;
+                    continue;
+                }
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+                flips = glm::dot(before, after) <= 0.0f || glm::length(after) < 1e-3f * glm::length(before);
+            }
+            if (flips)
+                continue;
+
+            collapseTo[c.from] = c.to;
+            quadrics[target].add(quadrics[c.from]);
+            error = std::max(error, (float)std::sqrt(c.cost));
+            removed += shared;
+            for (unsigned int a = triangleOffsets[c.from]; a < triangleOffsets[c.from + 1]; a++)
+                for (int k = 0; k < 3; k++)
+                    touched[canonical[current[triangleList[a] * 3 + k]]] = 1;
+        }
+        if (removed == 0)
+            break;
+
+        // Apply the pass: moved points take the target vertex, triangles that lost a corner disappear.
+        std::vector<unsigned int> next;
+        next.reserve(current.size());
+        for (size_t t = 0; t < current.size(); t += 3) {
+            unsigned int tri[3];
+            for (int k = 0; k < 3; k++) {
+                unsigned int v = current[t + k];
+                unsigned int moved = collapseTo[canonical[v]];
+                tri[k] = moved != canonical[v] ? moved : v;
+            }
+            if (canonical[tri[0]] == canonical[tri[1]] || canonical[tri[1]] == canonical[tri[2]] ||
+                canonical[tri[0]] == canonical[tri[2]])
+                continue;
+            next.insert(next.end(), tri, tri + 3);
+        }
+        current.swap(next);
+    }
+    return current;
+}
+
+std::vector<MeshLod> buildLodChain(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+    const std::vector<float>& ratios)
+{
+    std::vector<MeshLod> lods(1, MeshLod{ 0, (uint32_t)indices.size(), 0.0f });
+    size_t original = indices.size();
+    std::vector<unsigned int> previous(indices);
+    float previousError = 0.0f;
+    for (float ratio : ratios) {
+        size_t target = (size_t)(original * ratio) / 3 * 3;
+        if (target >= previous.size())
+            continue;
+        // Each level starts from the one before, so its error against the original is at most the sum.
+        float error;
+        std::vector<unsigned int> level = simplifyMesh(vertices, previous, target, error);
+        if (level.empty() || level.size() > previous.size() - previous.size() / 10)
+            break;
+        optimizeVertexCache(level, vertices.size());
+        previousError += error;
+        lods.push_back(MeshLod{ (uint32_t)indices.size(), (uint32_t)level.size(), previousError });
+        indices.insert(indices.end(), level.begin(), level.end());
+        previous.swap(level);
+    }
+    return lods;
+}
+
+void weldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, float epsilon)
+{
+    if (vertices.empty())
+        return;
+    // Power-of-two table at most half full, holding indices into welded.
+    size_t capacity = 1;
+    while (capacity < vertices.size() * 2)
+        capacity <<= 1;
+    std::vector<uint32_t> table(capacity, UNUSED);
+    std::vector<WeldKey> keys;
+    std::vector<Vertex> welded;
+    std::vector<uint32_t> remap(vertices.size(), UNUSED);
+
+    // Walk in index order so the merged vertices come out in first-use order.
+    for (unsigned int& index : indices) {
+        if (remap[index] == UNUSED) {
+            WeldKey key(vertices[index], epsilon);
+            size_t slot = key.hash() & (capacity - 1);
+            while (table[slot] != UNUSED && !(keys[table[slot]] == key))
+                slot = (slot + 1) & (capacity - 1);
+            if (table[slot] == UNUSED) {
+                table[slot] = (uint32_t)welded.size();
+                keys.push_back(key);
+                welded.push_back(vertices[index]);
+            }
+            remap[index] = table[slot];
+        }
+        index = remap[index];
+    }
+
+    if (epsilon > 0.0f) {
+        size_t kept = 0;
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            unsigned int a = indices[i], b = indices[i + 1], c = indices[i + 2];
+            if (a == b || b == c || c == a)
+                continue;
+            indices[kept++] = a;
+            indices[kept++] = b;
+            indices[kept++] = c;
+        }
+        indices.resize(kept);
+    }
+    vertices.swap(welded);
+}
+
+void transformMesh(MeshData& mesh, const glm::mat4& transform)
+{
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(transform)));
+    for (Vertex& v : mesh.vertices) {
+        v.Position = glm::vec3(transform * glm::vec4(v.Position, 1.0f));
+        if (v.Normal != glm::vec3(0.0f))
+            v.Normal = glm::normalize(normalMatrix * v.Normal);
+    }
+    if (glm::determinant(glm::mat3(transform)) < 0.0f)
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+            std::swap(mesh.indices[i + 1], mesh.indices[i + 2]);
+
+    if (!mesh.vertices.empty()) {
+        mesh.aabbMin = mesh.aabbMax = mesh.vertices[0].Position;
+        for (const Vertex& v : mesh.vertices) {
+            mesh.aabbMin = glm::min(mesh.aabbMin, v.Position);
+            mesh.aabbMax = glm::max(mesh.aabbMax, v.Position);
+        }
+    }
+}
+
+std::vector<MeshData> mergeByMaterial(std::vector<MeshData> meshes)
+{
+    std::vector<MeshData> batches;
+    std::unordered_map<std::string, size_t> batchOf;
+    for (MeshData& mesh : meshes) {
+        // Draws bind nothing but the textures, so their types and paths are the whole material.
+        std::string key;
+        for (const Texture& t : mesh.textures)
+            key += t.type + '\n' + t.path + '\n';
+
+        auto it = batchOf.find(key);
+        if (it == batchOf.end()) {
+            batchOf[key] = batches.size();
+            batches.push_back(std::move(mesh));
+            continue;
+        }
+        MeshData& batch = batches[it->second];
+        if (mesh.vertices.empty())
+            continue;
+        if (batch.vertices.empty()) {
+            batch.aabbMin = mesh.aabbMin;
+            batch.aabbMax = mesh.aabbMax;
+        }
+        unsigned int base = (unsigned int)batch.vertices.size();
+        batch.vertices.insert(batch.vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+        batch.indices.reserve(batch.indices.size() + mesh.indices.size());
+        for (unsigned int index : mesh.indices)
+            batch.indices.push_back(base + index);
+        batch.aabbMin = glm::min(batch.aabbMin, mesh.aabbMin);
+        batch.aabbMax = glm::max(batch.aabbMax, mesh.aabbMax);
+    }
+    return batches;
+}
@@ -0,0 +1,72 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstddef>
+#include <vector>
+#include "Mesh.h"
+
+// Load-time geometry processing on CPU-side mesh data. No GL; safe on worker threads.
+
+// Vertex count up to which a mesh can be drawn with GL_UNSIGNED_SHORT indices.
+const size_t MAX_SHORT_INDEX_VERTICES = 65536;
+
+// A piece of a split mesh, with its own vertices and bounds.
+struct MeshPart {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    glm::vec3 aabbMin = glm::vec3(0.0f);
+    glm::vec3 aabbMax = glm::vec3(0.0f);
+};
+
+// Splits a triangle list into parts of at most maxVertices vertices each, keeping the triangle order.
+std::vector<MeshPart> splitForShortIndices(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+    size_t maxVertices = MAX_SHORT_INDEX_VERTICES);
+
+// Merges vertices with the same position, normal and UV and rewrites indices to the merged set, keeping
+// first-use order; unreferenced vertices are dropped. With epsilon > 0 every component is snapped to an epsilon grid before comparing, and
+// triangles that collapse are dropped. A linear-probing hash table, so it is linear in the vertex count.
+void weldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, float epsilon = 0.0f);
+
+// Post-transform cache statistics: ACMR is misses per triangle (0.5 is ideal on closed meshes),
+// ATVR misses per referenced vertex (1.0 is ideal).
+struct VertexCacheStats {
+    float acmr = 0.0f;
+    float atvr = 0.0f;
+};
+
+// Simulates a FIFO post-transform cache of cacheSize entries over the triangle list.
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, int cacheSize = 16);
+
+// Reorders triangles for the post-transform vertex cache (Forsyth's linear-speed algorithm).
+void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount);
+
+// Reorders clusters of the cache-optimized order so outward-facing ones come first and hide what is behind them.
+// Keeps the input if the ACMR would grow by more than threshold.
+void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold = 1.05f);
+
+// Renumbers vertices in first-use order so fetches walk the buffer forward; unreferenced vertices are dropped.
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+// Quadric error metric edge collapse down to about targetIndexCount indices, reusing the existing vertices.
+// Vertices on open borders or attribute seams (same position, different normal or UV) never move.
+// error receives the largest collapse error, as a distance in mesh units.
+std::vector<unsigned int> simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+    size_t targetIndexCount, float& error);
+
+// Appends a simplified index list per ratio of the original triangle count to indices, each one cache-optimized,
+// and returns the LOD table (level 0 is the input). Stops early once a level saves less than 10% over the previous one.
+std::vector<MeshLod> buildLodChain(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+    const std::vector<float>& ratios);
+
+// Moves positions and normals by a node transform, flipping the winding if it mirrors, and refits the bounds.
+void transformMesh(MeshData& mesh, const glm::mat4& transform);
+
+// Concatenates meshes with the same textures into one mesh each, in order of first appearance.
+// Meshes must share a space (e.g. after transformMesh) and have no LODs yet.
+std::vector<MeshData> mergeByMaterial(std::vector<MeshData> meshes);
+
+// Runs the three passes above in order and returns the cache statistics before and after.
+void optimizeMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+    VertexCacheStats& before, VertexCacheStats& after);
+
+#endif
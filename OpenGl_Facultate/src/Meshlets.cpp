@@ -0,0 +1,254 @@
+#include "Meshlets.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace {
+
+const uint32_t UNUSED = 0xffffffffu;
+
+// Unclustered seeds looked at when a cluster has no connected triangle left to take.
+const size_t SEED_WINDOW = 32;
+
+// 10 bits per axis of a point normalized to the bounds, interleaved.
+uint32_t mortonCode(const glm::vec3& p, const glm::vec3& lo, const glm::vec3& size)
+{
+    uint32_t code = 0;
+    glm::vec3 t = glm::clamp((p - lo) / glm::max(size, glm::vec3(1e-20f)), 0.0f, 1.0f) * 1023.0f;
+    uint32_t x = (uint32_t)t.x, y = (uint32_t)t.y, z = (uint32_t)t.z;
+    for (int bit = 9; bit >= 0; bit--)
+        code = (code << 3) | (((x >> bit) & 1) << 2) | (((y >> bit) & 1) << 1) | ((z >> bit) & 1);
+    return code;
+}
+
+// Ritter's bounding sphere: start from a far pair, grow to take in any point still outside.
+void boundingSphere(const std::vector<glm::vec3>& points, glm::vec3& center, float& radius)
+{
+    const glm::vec3& first = points[0];
+    glm::vec3 a = first, b = first;
+    for (const glm::vec3& p : points)
+        if (glm::dot(p - first, p - first) > glm::dot(a - first, a - first))
+            a = p;
+    for (const glm::vec3& p : points)
+        if (glm::dot(p - a, p - a) > glm::dot(b - a, b - a))
+            b = p;
+    center = (a + b) * 0.5f;
+    radius = glm::length(b - a) * 0.5f;
+    for (const glm::vec3& p : points) {
+        float d = glm::length(p - center);
+        if (d > radius) {
+            float grown = (radius + d) * 0.5f;
+            center += (p - center) * ((grown - radius) / d);
+            radius = grown;
+        }
+    }
+}
+
+// Unit face normal, zero for a degenerate triangle.
+glm::vec3 faceNormal(const std::vector<Vertex>& vertices, const unsigned int* triangle)
+{
+    const glm::vec3& a = vertices[triangle[0]].Position;
+    glm::vec3 n = glm::cross(vertices[triangle[1]].Position - a, vertices[triangle[2]].Position - a);
+    float length = glm::length(n);
+    return length > 0.0f ? n / length : glm::vec3(0.0f);
+}
+
+// Sphere and normal cone of the meshlet's range of indices.
+void computeBounds(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, Meshlet& m)
+{
+    std::vector<glm::vec3> points, normals;
+    for (uint32_t i = m.indexOffset; i < m.indexOffset + m.indexCount; i += 3) {
+        for (int k = 0; k < 3; k++)
+            points.push_back(vertices[indices[i + k]].Position);
+        normals.push_back(faceNormal(vertices, &indices[i]));
+    }
+    boundingSphere(points, m.center, m.radius);
+
+    glm::vec3 sum(0.0f);
+    for (const glm::vec3& n : normals)
+        sum += n;
+    float length = glm::length(sum);
+    m.coneAxis = length > 1e-6f ? sum / length : glm::vec3(0.0f, 0.0f, 1.0f);
+    float minDot = length > 1e-6f ? 1.0f : -1.0f;
+    for (const glm::vec3& n : normals)
+        if (n != glm::vec3(0.0f))
+            minDot = std::min(minDot, glm::dot(n, m.coneAxis));
+    // No eye sees all of a hemisphere of normals from behind; 1 makes the test always fail.
+    m.coneCutoff = minDot <= 0.0f ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+}
+
+}
+
+std::vector<Meshlet> buildMeshlets(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, size_t indexCount,
+    size_t maxVertices, size_t maxTriangles)
+{
+    std::vector<Meshlet> meshlets;
+    size_t triangleCount = std::min(indexCount, indices.size()) / 3;
+    if (triangleCount == 0 || maxVertices < 3 || maxTriangles == 0)
+        return meshlets;
+
+    // Unit face normals (zero for degenerate triangles) and centroids.
+    std::vector<glm::vec3> normals(triangleCount), centroids(triangleCount);
+    glm::vec3 lo(vertices[indices[0]].Position), hi(lo);
+    for (size_t t = 0; t < triangleCount; t++) {
+        normals[t] = faceNormal(vertices, &indices[t * 3]);
+        centroids[t] = (vertices[indices[t * 3]].Position + vertices[indices[t * 3 + 1]].Position +
+            vertices[indices[t * 3 + 2]].Position) / 3.0f;
+        lo = glm::min(lo, centroids[t]);
+        hi = glm::max(hi, centroids[t]);
+    }
+
+    // Vertex -> triangles adjacency, compressed into one array.
+    std::vector<uint32_t> adjacencyStart(vertices.size() + 1, 0), adjacency(triangleCount * 3);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        adjacencyStart[indices[i] + 1]++;
+    for (size_t v = 0; v < vertices.size(); v++)
+        adjacencyStart[v + 1] += adjacencyStart[v];
+    std::vector<uint32_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+
+    // Seeds for new clusters, and for pieces that aren't connected to the current one, in Morton order
+    // so the next seed is usually close to where the last cluster started.
+    std::vector<uint32_t> seeds(triangleCount);
+    std::vector<uint32_t> codes(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++) {
+        seeds[t] = (uint32_t)t;
+        codes[t] = mortonCode(centroids[t], lo, hi - lo);
+    }
+    std::sort(seeds.begin(), seeds.end(), [&](uint32_t a, uint32_t b) { return codes[a] != codes[b] ? codes[a] < codes[b] : a < b; });
+    size_t seedCursor = 0;
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> vertexMeshlet(vertices.size(), UNUSED);  // last cluster each vertex joined
+    std::vector<std::vector<uint32_t>> clusters;
+    std::vector<uint32_t> candidates, clusterTriangles;
+    size_t clustered = 0;
+
+    while (clustered < triangleCount) {
+        uint32_t id = (uint32_t)clusters.size();
+        size_t clusterVertices = 0;
+        glm::vec3 normalSum(0.0f), boxMin(0.0f), boxMax(0.0f);
+        candidates.clear();
+        clusterTriangles.clear();
+
+        auto add = [&](uint32_t t) {
+            emitted[t] = true;
+            clusterTriangles.push_back(t);
+            normalSum += normals[t];
+            for (int k = 0; k < 3; k++) {
+                unsigned int v = indices[t * 3 + k];
+                const glm::vec3& p = vertices[v].Position;
+                if (clusterVertices == 0)
+                    boxMin = boxMax = p;
+                boxMin = glm::min(boxMin, p);
+                boxMax = glm::max(boxMax, p);
+                if (vertexMeshlet[v] != id) {
+                    vertexMeshlet[v] = id;
+                    clusterVertices++;
+                    for (uint32_t a = adjacencyStart[v]; a < adjacencyStart[v + 1]; a++)
+                        if (!emitted[adjacency[a]])
+                            candidates.push_back(adjacency[a]);
+                }
+            }
+        };
+        auto newVertices = [&](uint32_t t) {
+            size_t count = 0;
+            for (int k = 0; k < 3; k++)
+                count += vertexMeshlet[indices[t * 3 + k]] != id;
+            return count;
+        };
+
+        while (emitted[seeds[seedCursor]])
+            seedCursor++;
+        add(seeds[seedCursor]);
+
+        while (clusterTriangles.size() < maxTriangles) {
+            // Best neighbour: fewest new vertices, then closest to the cluster's mean normal.
+            glm::vec3 axis = glm::length(normalSum) > 1e-6f ? glm::normalize(normalSum) : glm::vec3(0.0f);
+            uint32_t best = UNUSED;
+            float bestScore = 0.0f;
+            size_t kept = 0;
+            for (uint32_t t : candidates) {
+                if (emitted[t])
+                    continue;
+                candidates[kept++] = t;
+                size_t extra = newVertices(t);
+                if (clusterVertices + extra > maxVertices)
+                    continue;
+                float score = (float)extra + 0.25f * (1.0f - glm::dot(normals[t], axis));
+                if (best == UNUSED || score < bestScore) {
+                    best = t;
+                    bestScore = score;
+                }
+            }
+            candidates.resize(kept);
+
+            if (best == UNUSED) {
+                // Nothing connected fits: continue with the nearest of the next few seeds, e.g. a neighbouring leaf.
+                while (seedCursor < seeds.size() && emitted[seeds[seedCursor]])
+                    seedCursor++;
+                glm::vec3 center = (boxMin + boxMax) * 0.5f;
+                float bestDistance = 0.0f;
+                for (size_t i = seedCursor, looked = 0; i < seeds.size() && looked < SEED_WINDOW; i++) {
+                    uint32_t t = seeds[i];
+                    if (emitted[t])
+                        continue;
+                    looked++;
+                    float distance = glm::length(centroids[t] - center);
+                    if (clusterVertices + newVertices(t) <= maxVertices && (best == UNUSED || distance < bestDistance)) {
+                        best = t;
+                        bestDistance = distance;
+                    }
+                }
+                if (best == UNUSED)
+                    break;
+            }
+            add(best);
+        }
+
+        clustered += clusterTriangles.size();
+        clusters.push_back(clusterTriangles);
+    }
+
+    // Keep the incoming order as far as the clusters allow: triangles in their original order inside a cluster,
+    // clusters by their earliest triangle, so a vertex cache and overdraw ordered list stays close to that order.
+    for (std::vector<uint32_t>& cluster : clusters)
+        std::sort(cluster.begin(), cluster.end());
+    std::sort(clusters.begin(), clusters.end(),
+        [](const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) { return a[0] < b[0]; });
+    std::vector<unsigned int> ordered;
+    ordered.reserve(triangleCount * 3);
+    for (const std::vector<uint32_t>& cluster : clusters) {
+        Meshlet m;
+        m.indexOffset = (uint32_t)ordered.size();
+        m.indexCount = (uint32_t)cluster.size() * 3;
+        for (uint32_t t : cluster)
+            for (int k = 0; k < 3; k++)
+                ordered.push_back(indices[t * 3 + k]);
+        meshlets.push_back(m);
+    }
+
+    std::copy(ordered.begin(), ordered.end(), indices.begin());
+    for (Meshlet& m : meshlets)
+        computeBounds(vertices, indices, m);
+    return meshlets;
+}
+
+ClusterCulling::ClusterCulling(const glm::mat4& model, const glm::mat4& viewProjection, const glm::vec3& worldEye, bool backfaces)
+    : frustum(viewProjection), model(model), backfaces(backfaces)
+{
+    eye = glm::vec3(glm::inverse(model) * glm::vec4(worldEye, 1.0f));
+    scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+}
+
+bool ClusterCulling::visible(const Meshlet& m) const
+{
+    // Facing is decided in object space: whether a plane faces a point survives any affine transform.
+    if (backfaces) {
+        glm::vec3 toCenter = m.center - eye;
+        if (glm::dot(toCenter, m.coneAxis) > m.coneCutoff * glm::length(toCenter) + m.radius)
+            return false;
+    }
+    return frustum.intersects(glm::vec3(model * glm::vec4(m.center, 1.0f)), m.radius * scale);
+}
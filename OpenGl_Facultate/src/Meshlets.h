@@ -0,0 +1,37 @@
+#ifndef MESHLETS_H
+#define MESHLETS_H
+
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Frustum.h"
+#include "Mesh.h"
+
+// Clustering of a triangle list into meshlets, and the per-instance tests that skip them. No GL.
+
+const size_t MESHLET_MAX_VERTICES = 64;
+const size_t MESHLET_MAX_TRIANGLES = 124;
+
+// Reorders indices[0, indexCount) so every cluster is a contiguous range and returns the clusters.
+// Clusters grow across shared vertices, preferring triangles that face the same way, so their cones stay narrow.
+// Triangles keep their relative order within a cluster and clusters follow their first triangle, so the
+// order optimizeMesh picked survives at cluster granularity.
+// Indices past indexCount (coarser LODs) are left alone.
+std::vector<Meshlet> buildMeshlets(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, size_t indexCount,
+    size_t maxVertices = MESHLET_MAX_VERTICES, size_t maxTriangles = MESHLET_MAX_TRIANGLES);
+
+// One instance seen from one camera, for rejecting its clusters before the draw.
+struct ClusterCulling {
+    Frustum frustum;
+    glm::mat4 model;
+    glm::vec3 eye;           // camera position in the instance's object space
+    float scale;             // largest axis scale of model, for the sphere radii
+    bool backfaces;          // also reject clusters facing away from eye; only right for one-sided geometry
+
+    // viewProjection and worldEye as used for the draw; worldEye is ignored unless backfaces is set.
+    ClusterCulling(const glm::mat4& model, const glm::mat4& viewProjection, const glm::vec3& worldEye, bool backfaces);
+
+    bool visible(const Meshlet& meshlet) const;
+};
+
+#endif
@@ -0,0 +1,30 @@
+#include "MipChain.h"
+#include <stb/stb_image_resize2.h>
+#include <algorithm>
+
+std::vector<ImageLevel> buildMipChain(const unsigned char* pixels, int width, int height, int components, bool srgb)
+{
+    std::vector<ImageLevel> levels;
+    const unsigned char* src = pixels;
+    int w = width, h = height;
+    while (w > 1 || h > 1) {
+        ImageLevel level;
+        level.width = std::max(1, w / 2);
+        level.height = std::max(1, h / 2);
+        level.pixels.resize((size_t)level.width * level.height * components);
+        // Old-style channel counts 1-4 map directly onto stbir's pixel layouts (RGBA = straight alpha).
+        if (srgb)
+            stbir_resize_uint8_srgb(src, w, h, w * components,
+                level.pixels.data(), level.width, level.height, level.width * components,
+                (stbir_pixel_layout)components);
+        else
+            stbir_resize_uint8_linear(src, w, h, w * components,
+                level.pixels.data(), level.width, level.height, level.width * components,
+                (stbir_pixel_layout)components);
+        levels.push_back(std::move(level));
+        src = levels.back().pixels.data();
+        w = levels.back().width;
+        h = levels.back().height;
+    }
+    return levels;
+}
@@ -0,0 +1,17 @@
+#ifndef MIP_CHAIN_H
+#define MIP_CHAIN_H
+
+#include <vector>
+
+// One level of a CPU-side mip pyramid, tightly packed rows.
+struct ImageLevel {
+    int width, height;
+    std::vector<unsigned char> pixels;
+};
+
+// Builds mip levels 1..n (down to 1x1) of an 8-bit image with stb_image_resize2, each from the previous one.
+// Level 0 is not copied; the caller keeps it. Runs on any thread, no GL.
+// srgb averages colour channels in linear light (alpha stays linear); leave it off for data such as masks.
+std::vector<ImageLevel> buildMipChain(const unsigned char* pixels, int width, int height, int components, bool srgb);
+
+#endif
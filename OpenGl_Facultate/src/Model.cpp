@@ -1,156 +1,661 @@
 #include "Model.h"
+#include "Frustum.h"
+#include "MappedIOSystem.h"
+#include "MemoryStats.h"
+#include "MeshOptimizer.h"
+#include "TextureRegistry.h"
+#include "TextureStreamer.h"
+#include "ThreadPool.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
 #include <iostream>
-#include <stb/stb_image.h>
-#include <cstring>
-
-// Utility function for loading a texture from file.
-unsigned int TextureFromFile(const char* path, const std::string& directory, bool gamma = false) {
-    std::string filename = std::string(path);
-    filename = directory + "/" + filename;
-
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else {
-        std::cout << "Texture failed to load at path: " << filename << std::endl;
-        stbi_image_free(data);
-    }
+#include <chrono>
+#include <future>
+#include <memory>
+
+ImportOptions ImportOptions::FastLoad() {
+    return ImportOptions();
+}
+
+ImportOptions ImportOptions::FastRender() {
+    ImportOptions o;
+    // optimizeMeshes replaces aiProcess_ImproveCacheLocality, which only orders for the vertex cache,
+    // and weldVertices aiProcess_JoinIdenticalVertices.
+    o.postProcess |= aiProcess_OptimizeMeshes;
+    o.weldVertices = true;
+    o.optimizeMeshes = true;
+    return o;
+}
 
-    return textureID;
+ImportOptions ImportOptions::StaticScene() {
+    ImportOptions o = FastRender();
+    o.batchByMaterial = true;
+    return o;
 }
 
-Model::Model(const std::string& path) {
+Model::Model(const std::string& path, const ImportOptions& options)
+    : options(options) {
     loadModel(path);
 }
 
+Model::~Model() {
+    for (auto& it : textures_loaded)
+        TextureRegistry::instance().release(it.second.id);
+}
+
 void Model::Draw(Shader& shader) {
-    for (unsigned int i = 0; i < meshes.size(); i++)
-        meshes[i].Draw(shader);
+    Draw(shader, LodSelection());
+}
+
+void Model::Draw(Shader& shader, const LodSelection& lods) {
+    drawMeshes(shader, lods, nullptr);
+}
+
+void Model::Draw(Shader& shader, const LodSelection& lods, const ClusterCulling& culling) {
+    drawMeshes(shader, lods, &culling);
+}
+
+void Model::drawMeshes(Shader& shader, const LodSelection& lods, const ClusterCulling* culling) {
+    if (atlas.textureID()) {
+        glActiveTexture(GL_TEXTURE0 + ATLAS_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, atlas.textureID());
+        glActiveTexture(GL_TEXTURE0);
+    }
+    for (unsigned int i = 0; i < meshes.size(); i++) {
+        int level = i < lods.levels.size() ? lods.levels[i] : 0;
+        if (culling && level == 0)
+            meshes[i].Draw(shader, *culling);
+        else
+            meshes[i].Draw(shader, level);
+    }
+    // Leave the shader set up for float vertices, as used by everything else.
+    shader.setVec3("posScale", glm::vec3(1.0f));
+    shader.setVec3("posOffset", glm::vec3(0.0f));
+    shader.setBool("octNormals", false);
+}
+
+void Model::SelectLods(LodSelection& lods, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection,
+    float viewportHeight) const {
+    lods.levels.resize(meshes.size(), 0);
+    float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    // Pixels per world unit at distance 1.
+    float pixelsPerUnit = 0.5f * projection[1][1] * viewportHeight;
+    for (size_t i = 0; i < meshes.size(); i++) {
+        const Mesh& mesh = meshes[i];
+        glm::vec3 center = glm::vec3(model * glm::vec4((mesh.aabbMin + mesh.aabbMax) * 0.5f, 1.0f));
+        float radius = 0.5f * glm::length(mesh.aabbMax - mesh.aabbMin) * scale;
+        // Nearest point of the bounds, so a large mesh is judged by its closest part.
+        float distance = std::max(-(view * glm::vec4(center, 1.0f)).z - radius, 1e-3f);
+        auto pixels = [&](int level) { return mesh.lods[level].error * scale * pixelsPerUnit / distance; };
+
+        int level = std::min(lods.levels[i], (int)mesh.lods.size() - 1);
+        if (pixels(level) > lodPixelError) {
+            // Too coarse: refine until the error fits.
+            while (level > 0 && pixels(level) > lodPixelError)
+                level--;
+        }
+        else {
+            // Only coarsen once the next level is comfortably under the limit, so it doesn't flip back next frame.
+            while (level + 1 < (int)mesh.lods.size() && pixels(level + 1) <= lodPixelError * (1.0f - lodHysteresis))
+                level++;
+        }
+        lods.levels[i] = level;
+    }
+}
+
+void Model::UpdateStreaming(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection, float viewportHeight) {
+    float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    for (const Mesh& mesh : meshes) {
+        glm::vec3 center = glm::vec3(model * glm::vec4((mesh.aabbMin + mesh.aabbMax) * 0.5f, 1.0f));
+        float radius = 0.5f * glm::length(mesh.aabbMax - mesh.aabbMin) * scale;
+        float distance = -(view * glm::vec4(center, 1.0f)).z;
+
+        // Projected diameter in pixels; inside the bounds, ask for full resolution.
+        float pixels = distance > radius ? radius * projection[1][1] / distance * viewportHeight : 1e9f;
+        float texels = pixels / std::max(mesh.uvExtent, 1e-3f);
+        for (const Texture& texture : mesh.textures)
+            TextureStreamer::instance().requestResolution(texture.id, texels);
+    }
 }
 
 void Model::loadModel(const std::string& path) {
-    Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(path,
-        aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-        std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    directory = path.substr(0, path.find_last_of('/'));
+
+    MappedFile source;
+    if (!source.open(path)) {
+        std::cout << "ERROR::MODEL::FILE_NOT_FOUND::" << path << std::endl;
         return;
     }
-    directory = path.substr(0, path.find_last_of('/'));
-    processNode(scene->mRootNode, scene);
+    // The import steps change the output too, so they are part of the cache key.
+    uint64_t sourceHash = hashBytes(source.data(), source.size());
+    sourceHash = hashBytes(&options.postProcess, sizeof(options.postProcess), sourceHash);
+    sourceHash = hashBytes(&options.optimizeMeshes, sizeof(options.optimizeMeshes), sourceHash);
+    sourceHash = hashBytes(&options.weldVertices, sizeof(options.weldVertices), sourceHash);
+    sourceHash = hashBytes(&options.weldEpsilon, sizeof(options.weldEpsilon), sourceHash);
+    sourceHash = hashBytes(&options.batchByMaterial, sizeof(options.batchByMaterial), sourceHash);
+    sourceHash = hashBytes(&options.splitLargeMeshes, sizeof(options.splitLargeMeshes), sourceHash);
+    sourceHash = hashBytes(&options.buildMeshlets, sizeof(options.buildMeshlets), sourceHash);
+    sourceHash = hashBytes(options.lodRatios.data(), options.lodRatios.size() * sizeof(float), sourceHash);
+    source.close();
+
+    // Cooked cache next to the source file, rebuilt whenever the source content changes.
+    std::string cachePath = path + ".meshcache";
+    std::vector<MeshData> imported;
+    std::vector<EncodedImage> embedded;
+    if (options.useCache && cooked.open(cachePath, sourceHash)) {
+        loadedFromCache = true;
+        for (size_t i = 0; i < cooked.images(); i++)
+            embedded.push_back(cooked.image(i));
+    }
+    else {
+        if (!importModel(path, options, imported, embedded))
+            return;
+        if (options.useCache && !CookedModel::write(cachePath, sourceHash, imported, embedded, options.compressCache))
+            std::cout << "WARNING::MODEL::CACHE_WRITE_FAILED::" << cachePath << std::endl;
+        // Lazy meshes are read back from the cache, so map the file just written.
+        else if (options.useCache && options.lazyLoad && cooked.open(cachePath, sourceHash))
+            imported.clear();
+    }
+    loadEmbeddedTextures(path, embedded);
+    embedded.clear();
+
+    if (options.packTextures) {
+        std::vector<std::vector<Texture>> meshTextures;
+        for (size_t i = 0; i < cooked.size(); i++)
+            meshTextures.push_back(cooked.mesh(i).textures);
+        for (const MeshData& data : imported)
+            meshTextures.push_back(data.textures);
+        buildAtlas(meshTextures);
+    }
+
+    if (cooked.size() && options.lazyLoad) {
+        // Only the bounds for now; the mapped vertex and index pages are touched once the mesh is seen.
+        for (size_t i = 0; i < cooked.size(); i++) {
+            CookedModel::MeshView view = cooked.mesh(i);
+            pending.push_back(PendingMesh{ i, view.aabbMin, view.aabbMax });
+        }
+    }
+    else {
+        for (size_t i = 0; i < cooked.size(); i++)
+            addCookedMesh(i);
+        cooked.close();
+        for (MeshData& data : imported)
+            addMesh(std::move(data));
+    }
+
+    loadMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "MODEL::LOAD::" << path << " " << meshes.size() << " meshes in " << loadMilliseconds
+        << " ms (" << (loadedFromCache ? "cooked cache" : "assimp import") << ", " << pending.size()
+        << " deferred until visible)" << std::endl;
+    reportMemory();
+}
+
+void Model::reportMemory() const {
+    size_t kept = 0, indexBytes = 0, wideIndexBytes = 0, vertexBytes = 0;
+    int shortMeshes = 0;
+    for (const Mesh& mesh : meshes) {
+        kept += mesh.cpuBytes();
+        indexBytes += mesh.indexBytes();
+        vertexBytes += mesh.vertexBytes();
+        wideIndexBytes += (size_t)mesh.indexCount * sizeof(unsigned int);
+        shortMeshes += mesh.indexType == GL_UNSIGNED_SHORT ? 1 : 0;
+    }
+    const char* policy = options.residency == MeshResidency::Keep ? "keep"
+        : options.residency == MeshResidency::KeepPositions ? "keep positions" : "discard after upload";
+    std::cout << "MODEL::MEMORY::" << policy << ": " << kept / (1024.0 * 1024.0) << " MB of mesh data on the CPU, "
+        << releasedCpuBytes / (1024.0 * 1024.0) << " MB released, RSS " << currentRSS() / (1024.0 * 1024.0)
+        << " MB" << std::endl;
+    std::cout << "MODEL::MEMORY::indices: " << shortMeshes << " of " << meshes.size() << " meshes 16-bit, "
+        << indexBytes / (1024.0 * 1024.0) << " MB (" << wideIndexBytes / (1024.0 * 1024.0) << " MB at 32-bit)" << std::endl;
+    std::cout << "MODEL::MEMORY::vertices: " << vertexBytes / (1024.0 * 1024.0) << " MB uploaded"
+        << (options.positionStream ? ", position streams included" : "") << std::endl;
+}
+
+void Model::UpdateVisibility(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection) {
+    if (pending.empty())
+        return;
+    Frustum frustum(projection * view);
+    int loads = 0;
+    for (size_t i = 0; i < pending.size() && loads < options.lazyLoadsPerFrame; ) {
+        if (!frustum.intersects(model, pending[i].aabbMin, pending[i].aabbMax, options.prefetchMargin)) {
+            i++;
+            continue;
+        }
+        addCookedMesh(pending[i].index);
+        pending.erase(pending.begin() + i);
+        loads++;
+    }
+    if (pending.empty()) {
+        // Everything is resident, the mapping is no longer needed.
+        cooked.close();
+        std::cout << "MODEL::LAZY::all " << meshes.size() << " meshes loaded" << std::endl;
+        reportMemory();
+    }
+}
+
+bool Model::ImportMeshes(const std::string& path, const ImportOptions& options, std::vector<MeshData>& out) {
+    std::vector<EncodedImage> images;
+    return importModel(path, options, out, images);
+}
+
+bool Model::importModel(const std::string& path, const ImportOptions& options, std::vector<MeshData>& out,
+    std::vector<EncodedImage>& images) {
+    // Shared, so the embedded textures can point into the scene until they are decoded.
+    std::shared_ptr<Assimp::Importer> importer = std::make_shared<Assimp::Importer>();
+    if (options.mappedIO)
+        importer->SetIOHandler(new MappedIOSystem());  // the importer owns and deletes it
+    const aiScene* scene = readScene(*importer, path, options);
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+        std::cout << "ERROR::ASSIMP::" << importer->GetErrorString() << std::endl;
+        return false;
+    }
+
+    // Compressed embedded textures (mHeight 0) hold the image file as it was stored; stb decodes them in place.
+    for (unsigned int i = 0; i < scene->mNumTextures; i++) {
+        const aiTexture* texture = scene->mTextures[i];
+        EncodedImage image;
+        if (texture->mHeight == 0) {
+            image.data = std::shared_ptr<const unsigned char>(importer, reinterpret_cast<const unsigned char*>(texture->pcData));
+            image.size = texture->mWidth;
+        }
+        else {
+            std::cout << "WARNING::MODEL::EMBEDDED_TEXTURE_UNCOMPRESSED::*" << i << " not supported" << std::endl;
+        }
+        images.push_back(image);
+    }
+
+    // Walk the node tree first, then convert the meshes on the worker threads.
+    // Each future owns one slot, so the result keeps the node-walk order.
+    std::vector<SceneMesh> sceneMeshes;
+    processNode(scene->mRootNode, scene, glm::mat4(1.0f), sceneMeshes);
+
+    struct Welded {
+        MeshData data;
+        size_t verticesBefore;
+    };
+    bool batch = options.batchByMaterial;
+    bool weld = options.weldVertices;
+    float weldEpsilon = options.weldEpsilon;
+    std::vector<std::future<Welded>> converting;
+    converting.reserve(sceneMeshes.size());
+    for (const SceneMesh& placed : sceneMeshes) {
+        converting.push_back(ThreadPool::shared().enqueue([placed, scene, batch, weld, weldEpsilon]() {
+            Welded w;
+            w.data = processMesh(placed.mesh, scene);
+            w.verticesBefore = w.data.vertices.size();
+            if (weld)
+                weldVertices(w.data.vertices, w.data.indices, weldEpsilon);
+            if (batch && placed.transform != glm::mat4(1.0f))
+                transformMesh(w.data, placed.transform);
+            return w;
+        }));
+    }
+    std::vector<MeshData> converted;
+    converted.reserve(converting.size());
+    size_t totalBefore = 0, totalAfter = 0;
+    for (size_t i = 0; i < converting.size(); i++) {
+        Welded w = converting[i].get();
+        if (weld && options.report)
+            std::cout << "MODEL::WELD::mesh " << i << " vertices " << w.verticesBefore << " -> " << w.data.vertices.size()
+                << std::endl;
+        totalBefore += w.verticesBefore;
+        totalAfter += w.data.vertices.size();
+        converted.push_back(std::move(w.data));
+    }
+    if (weld && options.report && totalBefore)
+        std::cout << "MODEL::WELD::" << totalBefore << " -> " << totalAfter << " vertices ("
+            << 100.0 * (totalBefore - totalAfter) / totalBefore << "% fewer)" << std::endl;
+    if (batch) {
+        converted = mergeByMaterial(std::move(converted));
+        if (options.report)
+            std::cout << "MODEL::BATCH::" << sceneMeshes.size() << " draw calls -> " << converted.size()
+                << " (one per material)" << std::endl;
+    }
+    // Split before the optimizer and LODs, so every 16-bit part gets its own chain.
+    if (options.splitLargeMeshes) {
+        std::vector<MeshData> split;
+        for (MeshData& data : converted) {
+            if (data.vertices.size() <= MAX_SHORT_INDEX_VERTICES) {
+                split.push_back(std::move(data));
+                continue;
+            }
+            for (MeshPart& part : splitForShortIndices(data.vertices, data.indices)) {
+                MeshData piece;
+                piece.vertices = std::move(part.vertices);
+                piece.indices = std::move(part.indices);
+                piece.textures = data.textures;
+                piece.aabbMin = part.aabbMin;
+                piece.aabbMax = part.aabbMax;
+                split.push_back(std::move(piece));
+            }
+        }
+        converted = std::move(split);
+    }
+
+    // The optimizer and LODs run on the batches, so they see the whole merged mesh.
+    struct Converted {
+        MeshData data;
+        VertexCacheStats before, after;
+    };
+    bool optimize = options.optimizeMeshes;
+    bool cluster = options.buildMeshlets;
+    std::vector<float> lodRatios = options.lodRatios;
+    std::vector<std::future<Converted>> pending;
+    pending.reserve(converted.size());
+    for (MeshData& data : converted) {
+        MeshData* source = &data;
+        pending.push_back(ThreadPool::shared().enqueue([source, optimize, cluster, lodRatios]() {
+            Converted c;
+            c.data = std::move(*source);
+            if (optimize)
+                optimizeMesh(c.data.vertices, c.data.indices, c.before, c.after);
+            if (!lodRatios.empty())
+                c.data.lods = buildLodChain(c.data.vertices, c.data.indices, lodRatios);
+            // Last, as it reorders level 0; it keeps the optimizer's order within and across clusters.
+            if (cluster)
+                c.data.meshlets = buildMeshlets(c.data.vertices, c.data.indices,
+                    c.data.lods.empty() ? c.data.indices.size() : c.data.lods[0].indexCount);
+            return c;
+        }));
+    }
+
+    out.reserve(out.size() + pending.size());
+    for (size_t i = 0; i < pending.size(); i++) {
+        Converted c = pending[i].get();
+        if (optimize && options.report)
+            std::cout << "MODEL::OPTIMIZE::mesh " << i << " ACMR " << c.before.acmr << " -> " << c.after.acmr
+                << ", ATVR " << c.before.atvr << " -> " << c.after.atvr << std::endl;
+        if (!c.data.lods.empty() && options.report) {
+            std::cout << "MODEL::LOD::mesh " << i << " triangles";
+            for (const MeshLod& lod : c.data.lods)
+                std::cout << " " << lod.indexCount / 3 << " (error " << lod.error << ")";
+            std::cout << std::endl;
+        }
+        out.push_back(std::move(c.data));
+    }
+    return true;
+}
+
+namespace {
+
+// Post-process steps in the order they are applied: Triangulate before the steps that need triangles,
+// JoinIdenticalVertices before ImproveCacheLocality, as in Assimp's own pipeline.
+const struct { unsigned int flag; const char* name; } IMPORT_STEPS[] = {
+    { aiProcess_PreTransformVertices,  "PreTransformVertices" },
+    { aiProcess_Triangulate,           "Triangulate" },
+    { aiProcess_SortByPType,           "SortByPType" },
+    { aiProcess_OptimizeMeshes,        "OptimizeMeshes" },
+    { aiProcess_GenSmoothNormals,      "GenSmoothNormals" },
+    { aiProcess_CalcTangentSpace,      "CalcTangentSpace" },
+    { aiProcess_JoinIdenticalVertices, "JoinIdenticalVertices" },
+    { aiProcess_ImproveCacheLocality,  "ImproveCacheLocality" },
+    { aiProcess_FlipUVs,               "FlipUVs" },
+};
+
+void countGeometry(const aiScene* scene, size_t& vertices, size_t& indices) {
+    vertices = indices = 0;
+    for (unsigned int i = 0; scene && i < scene->mNumMeshes; i++) {
+        vertices += scene->mMeshes[i]->mNumVertices;
+        for (unsigned int f = 0; f < scene->mMeshes[i]->mNumFaces; f++)
+            indices += scene->mMeshes[i]->mFaces[f].mNumIndices;
+    }
+}
+
+
+// Material paths of textures stored inside the model file, as materialTextureRefs names them.
+bool isEmbedded(const std::string& path) {
+    return !path.empty() && path[0] == '*';
+}
+
 }
 
-void Model::processNode(aiNode* node, const aiScene* scene) {
-    // Process all the node's meshes (if any)
-    for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(processMesh(mesh, scene));
+const aiScene* Model::readScene(Assimp::Importer& importer, const std::string& path, const ImportOptions& options) {
+    if (!options.report)
+        return importer.ReadFile(path, options.postProcess);
+
+    // Assimp's profiler (AI_CONFIG_GLOB_MEASURE_TIME) logs every step under the same "postprocess" region,
+    // so the steps are applied one at a time here to attribute time and geometry to each.
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&start]() {
+        auto now = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(now - start).count();
+        start = now;
+        return ms;
+    };
+    size_t vertices, indices;
+
+    const aiScene* scene = importer.ReadFile(path, 0);
+    double ms = elapsed();
+    countGeometry(scene, vertices, indices);
+    std::cout << "MODEL::IMPORT::read " << ms << " ms, " << vertices << " vertices, " << indices << " indices" << std::endl;
+
+    unsigned int remaining = options.postProcess;
+    for (const auto& step : IMPORT_STEPS) {
+        if (!scene || !(remaining & step.flag))
+            continue;
+        remaining &= ~step.flag;
+        scene = importer.ApplyPostProcessing(step.flag);
+        ms = elapsed();
+        countGeometry(scene, vertices, indices);
+        std::cout << "MODEL::IMPORT::" << step.name << " " << ms << " ms, " << vertices << " vertices, "
+            << indices << " indices" << std::endl;
+    }
+    if (scene && remaining) {
+        scene = importer.ApplyPostProcessing(remaining);
+        ms = elapsed();
+        countGeometry(scene, vertices, indices);
+        std::cout << "MODEL::IMPORT::other steps " << ms << " ms, " << vertices << " vertices, "
+            << indices << " indices" << std::endl;
     }
+    return scene;
+}
+
+void Model::processNode(aiNode* node, const aiScene* scene, const glm::mat4& parentTransform, std::vector<SceneMesh>& out) {
+    // aiMatrix4x4 is row-major, glm column-major
+    glm::mat4 transform = parentTransform * glm::transpose(glm::make_mat4(&node->mTransformation.a1));
+    // Collect all the node's meshes (if any)
+    for (unsigned int i = 0; i < node->mNumMeshes; i++)
+        out.push_back(SceneMesh{ scene->mMeshes[node->mMeshes[i]], transform });
     // Then do the same for each of its children
     for (unsigned int i = 0; i < node->mNumChildren; i++) {
-        processNode(node->mChildren[i], scene);
+        processNode(node->mChildren[i], scene, transform, out);
     }
 }
 
-Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
-    std::vector<Texture> textures;
+void Model::addCookedMesh(size_t index) {
+    CookedModel::MeshView view = cooked.mesh(index);
+    if (view.vertexCount == 0)
+        return;
+    MeshData data;
+    data.textures = std::move(view.textures);
+    data.aabbMin = view.aabbMin;
+    data.aabbMax = view.aabbMax;
+    data.lods = std::move(view.lods);
+    data.meshlets = std::move(view.meshlets);
+    // Raw geometry that needs no CPU copy goes to the GPU straight from the mapping.
+    if (view.decodedVertices.empty() && view.decodedIndices.empty() && options.residency == MeshResidency::DiscardAfterUpload) {
+        addMesh(std::move(data), view.vertices, view.vertexCount, view.indices, view.indexCount);
+        return;
+    }
+    // Decoded arrays are already ours; raw ones are copied out of the mapping.
+    if (!view.decodedVertices.empty())
+        data.vertices = std::move(view.decodedVertices);
+    else
+        data.vertices.assign(view.vertices, view.vertices + view.vertexCount);
+    if (!view.decodedIndices.empty())
+        data.indices = std::move(view.decodedIndices);
+    else
+        data.indices.assign(view.indices, view.indices + view.indexCount);
+    addMesh(std::move(data));
+}
+
+void Model::addMesh(MeshData data) {
+    const Vertex* vertices = data.vertices.data();
+    size_t vertexCount = data.vertices.size();
+    // Moving keeps the vector's storage, so vertices still points at it inside the mesh.
+    meshes.emplace_back(std::move(data.vertices), std::move(data.indices), std::vector<Texture>(), options.quantizeVertices,
+        std::move(data.lods), options.positionStream);
+    finishMesh(data, vertices, vertexCount);
+}
+
+void Model::addMesh(MeshData data, const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount) {
+    meshes.emplace_back(vertices, vertexCount, indices, indexCount, std::vector<Texture>(), options.quantizeVertices,
+        std::move(data.lods), options.positionStream);
+    finishMesh(data, vertices, vertexCount);
+}
+
+void Model::finishMesh(MeshData& data, const Vertex* vertices, size_t vertexCount) {
+    std::vector<Texture>& textures = data.textures;
+    // A packed diffuse texture is drawn from the atlas and never loaded on its own.
+    AtlasEntry packed = { -1, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f) };
+    for (auto it = textures.begin(); it != textures.end(); ++it) {
+        if (it->type == "texture_diffuse" && atlas.find(directory + "/" + it->path, packed)) {
+            textures.erase(it);
+            break;
+        }
+    }
+    loadMaterialTextures(textures);
+    glm::vec2 uvMin(0.0f), uvMax(0.0f);
+    if (vertexCount) {
+        uvMin = uvMax = vertices[0].TexCoords;
+        for (size_t i = 0; i < vertexCount; i++) {
+            uvMin = glm::min(uvMin, vertices[i].TexCoords);
+            uvMax = glm::max(uvMax, vertices[i].TexCoords);
+        }
+    }
+    meshes.back().textures = std::move(textures);
+    meshes.back().meshlets = std::move(data.meshlets);
+    meshes.back().aabbMin = data.aabbMin;
+    meshes.back().aabbMax = data.aabbMax;
+    meshes.back().uvExtent = std::max(uvMax.x - uvMin.x, uvMax.y - uvMin.y);
+    meshes.back().atlasLayer = packed.layer;
+    meshes.back().atlasRect = packed.rect;
 
-    // Process vertices
+    size_t before = meshes.back().cpuBytes();
+    meshes.back().releaseCpuData(options.residency);
+    releasedCpuBytes += before - meshes.back().cpuBytes();
+}
+
+MeshData Model::processMesh(aiMesh* mesh, const aiScene* scene) {
+    MeshData data;
+    std::vector<Vertex>& vertices = data.vertices;
+    std::vector<unsigned int>& indices = data.indices;
+    std::vector<Texture>& textures = data.textures;
+
+    // Process vertices, written in place into a presized array
+    vertices.resize(mesh->mNumVertices);
+    const aiVector3D* texCoords = mesh->mTextureCoords[0];
     for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-        Vertex vertex;
-        glm::vec3 vector;
+        Vertex& vertex = vertices[i];
         // Positions
-        vector.x = mesh->mVertices[i].x;
-        vector.y = mesh->mVertices[i].y;
-        vector.z = mesh->mVertices[i].z;
-        vertex.Position = vector;
+        vertex.Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
         // Normals
-        if (mesh->HasNormals()) {
-            vector.x = mesh->mNormals[i].x;
-            vector.y = mesh->mNormals[i].y;
-            vector.z = mesh->mNormals[i].z;
-            vertex.Normal = vector;
-        }
+        if (mesh->HasNormals())
+            vertex.Normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+        else
+            vertex.Normal = glm::vec3(0.0f);
         // Texture coordinates
-        if (mesh->mTextureCoords[0]) {
-            glm::vec2 vec;
-            vec.x = mesh->mTextureCoords[0][i].x;
-            vec.y = mesh->mTextureCoords[0][i].y;
-            vertex.TexCoords = vec;
-        }
-        else {
+        if (texCoords)
+            vertex.TexCoords = glm::vec2(texCoords[i].x, texCoords[i].y);
+        else
             vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+    }
+
+    // Bounds
+    if (!vertices.empty()) {
+        data.aabbMin = data.aabbMax = vertices[0].Position;
+        for (const Vertex& v : vertices) {
+            data.aabbMin = glm::min(data.aabbMin, v.Position);
+            data.aabbMax = glm::max(data.aabbMax, v.Position);
         }
-        vertices.push_back(vertex);
     }
 
     // Process indices
+    size_t indexCount = 0;
+    for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+        indexCount += mesh->mFaces[i].mNumIndices;
+    indices.resize(indexCount);
+    unsigned int* dst = indices.data();
     for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-        aiFace face = mesh->mFaces[i];
+        const aiFace& face = mesh->mFaces[i];
         for (unsigned int j = 0; j < face.mNumIndices; j++)
-            indices.push_back(face.mIndices[j]);
+            *dst++ = face.mIndices[j];
     }
 
     // Process material textures
     if (mesh->mMaterialIndex >= 0) {
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-        std::vector<Texture> diffuseMaps = loadMaterialTextures(material,
+        std::vector<Texture> diffuseMaps = materialTextureRefs(scene, material,
             aiTextureType_DIFFUSE, "texture_diffuse");
         textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
 
-        std::vector<Texture> specularMaps = loadMaterialTextures(material,
+        std::vector<Texture> specularMaps = materialTextureRefs(scene, material,
             aiTextureType_SPECULAR, "texture_specular");
         textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
     }
 
-    return Mesh(vertices, indices, textures);
+    return data;
 }
 
-std::vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName) {
+std::vector<Texture> Model::materialTextureRefs(const aiScene* scene, aiMaterial* mat, aiTextureType type,
+    std::string typeName) {
     std::vector<Texture> textures;
     for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
         aiString str;
         mat->GetTexture(type, i, &str);
-        bool skip = false;
-        for (unsigned int j = 0; j < textures_loaded.size(); j++) {
-            if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0) {
-                textures.push_back(textures_loaded[j]);
-                skip = true;
-                break;
-            }
+        Texture texture;
+        texture.id = 0;
+        texture.type = typeName;
+        texture.path = str.C_Str();
+        // FBX refers to embedded textures by their original file name; glTF and others by "*index".
+        int embedded = scene->GetEmbeddedTextureAndIndex(str.C_Str()).second;
+        if (embedded >= 0)
+            texture.path = "*" + std::to_string(embedded);
+        textures.push_back(texture);
+    }
+    return textures;
+}
+
+void Model::buildAtlas(const std::vector<std::vector<Texture>>& meshTextures) {
+    // Only the first diffuse map of each mesh is sampled, so only those are packed.
+    std::vector<std::string> paths;
+    for (const std::vector<Texture>& textures : meshTextures) {
+        for (const Texture& texture : textures) {
+            if (texture.type != "texture_diffuse")
+                continue;
+            // Embedded textures have no file to pack from.
+            std::string path = directory + "/" + texture.path;
+            if (!isEmbedded(texture.path) && std::find(paths.begin(), paths.end(), path) == paths.end())
+                paths.push_back(path);
+            break;
         }
-        if (!skip) {
-            Texture texture;
-            texture.id = TextureFromFile(str.C_Str(), directory);
-            texture.type = typeName;
-            texture.path = str.C_Str();
-            textures.push_back(texture);
-            textures_loaded.push_back(texture);
+    }
+    atlas.build(paths, options.packMaxSize);
+}
+
+void Model::loadEmbeddedTextures(const std::string& path, const std::vector<EncodedImage>& images) {
+    for (size_t i = 0; i < images.size(); i++) {
+        Texture texture;
+        texture.type = "";
+        texture.path = "*" + std::to_string(i);
+        // Named after the model, so messages and the BC cache (<model>#<index>.dxt) point back to it.
+        texture.id = TextureRegistry::instance().acquire(path + "#" + std::to_string(i), images[i]);
+        textures_loaded[texture.path] = texture;
+    }
+    if (!images.empty() && options.report)
+        std::cout << "MODEL::TEXTURES::" << images.size() << " embedded textures decoding from memory" << std::endl;
+}
+
+void Model::loadMaterialTextures(std::vector<Texture>& textures) {
+    for (Texture& texture : textures) {
+        auto loaded = textures_loaded.find(texture.path);
+        if (loaded != textures_loaded.end()) {
+            texture.id = loaded->second.id;
+            continue;
         }
+        // One registry reference per distinct path, released in the destructor.
+        texture.id = TextureRegistry::instance().acquire(directory + "/" + texture.path);
+        textures_loaded[texture.path] = texture;
     }
-    return textures;
 }
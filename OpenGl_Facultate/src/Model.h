@@ -9,33 +9,182 @@
 #include <assimp/postprocess.h>
 #include <assimp/Importer.hpp>
 #include "Mesh.h"
+#include "MeshCache.h"
+#include "Meshlets.h"
+#include "TextureAtlas.h"
 #include "shader.h"
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+// How a model is imported: the Assimp post-process steps plus our own processing options.
+struct ImportOptions {
+    unsigned int postProcess = aiProcess_Triangulate | aiProcess_FlipUVs;
+    // Read and write the cooked mesh cache next to the source file.
+    bool useCache = true;
+    // Store the cache's vertices and indices through MeshCodec; applies whenever the cache is (re)written.
+    bool compressCache = false;
+    // Serve Assimp's file reads from memory mappings instead of its default buffered file IO.
+    bool mappedIO = true;
+    // Pack diffuse textures up to packMaxSize texels across into one texture array, bound once per draw.
+    bool packTextures = false;
+    int packMaxSize = 256;
+    // Load only the bounds up front; a mesh's geometry is read from the cooked cache and uploaded
+    // the first time it comes within prefetchMargin world units of the view frustum.
+    bool lazyLoad = false;
+    float prefetchMargin = 5.0f;
+    int lazyLoadsPerFrame = 4;
+    // CPU copies of the geometry kept after upload.
+    MeshResidency residency = MeshResidency::Keep;
+    // Upload 16-byte PackedVertex data instead of 32-byte float vertices; the shaders dequantize.
+    bool quantizeVertices = false;
+    // Also upload a position-only copy of every mesh for depth and shadow passes, which fetch
+    // 12 (or 8 quantized) bytes per vertex from it instead of the full vertex.
+    bool positionStream = false;
+    // Split meshes over 65536 vertices at import, so every part can use 16-bit indices and gets its own LODs.
+    bool splitLargeMeshes = false;
+    // Reorder triangles for the vertex cache and overdraw, then vertices for fetch; stored in the cooked cache.
+    bool optimizeMeshes = false;
+    // Fractions of the triangle count to build LOD levels at, e.g. {0.5, 0.25, 0.1}; empty for none.
+    std::vector<float> lodRatios;
+    // Merge the per-face vertices 3DS and OBJ arrive with, in place of aiProcess_JoinIdenticalVertices.
+    // weldEpsilon > 0 also merges vertices whose components differ by less than about that much.
+    bool weldVertices = false;
+    float weldEpsilon = 0.0f;
+    // Bake node transforms into the vertices and merge meshes with the same textures into one mesh each,
+    // so the model draws in one call per material (plus any 16-bit splits).
+    bool batchByMaterial = false;
+    // Cluster each mesh's full-detail triangles into meshlets at import, after the optimizer, so Draw with
+    // a ClusterCulling can skip the ones outside the view or facing away from it; stored in the cooked cache.
+    bool buildMeshlets = false;
+    // Print per-step timings and vertex/index counts after every import.
+    bool report = true;
+
+    // Fewest steps: whatever Assimp hands back, triangulated.
+    static ImportOptions FastLoad();
+    // Welded vertices, merged meshes and our vertex cache/overdraw/fetch pass; slower import, faster draws.
+    static ImportOptions FastRender();
+    // FastRender plus node transforms baked in and meshes batched by material, for models that never animate.
+    static ImportOptions StaticScene();
+};
+
+// Unit the texture atlas is bound to, above the units Mesh::Draw hands out to per-mesh textures.
+// Shaders with an atlasTex sampler point it here once, atlas or not, so it never shares unit 0 with a sampler2D.
+const int ATLAS_TEXTURE_UNIT = 8;
+
+// Per-instance LOD state: the level each mesh of one drawn copy is at, kept between frames for hysteresis.
+struct LodSelection {
+    std::vector<int> levels;
+};
+
 class Model {
 public:
     // Model data
-    std::vector<Texture> textures_loaded; // stores all the textures loaded so far
+    std::unordered_map<std::string, Texture> textures_loaded; // textures loaded so far, keyed by material path
     std::vector<Mesh> meshes;
     std::string directory;
+    // Load statistics, reported on startup
+    bool loadedFromCache = false;
+    double loadMilliseconds = 0.0;
+    size_t releasedCpuBytes = 0;  // mesh data freed after upload by the residency policy
+
+    ImportOptions options;
+    // Small diffuse textures shared by all meshes, when options.packTextures is set
+    TextureAtlas atlas;
+    // LOD selection: largest acceptable simplification error in pixels, and how far below it
+    // (as a fraction) a coarser level must be before switching to it.
+    float lodPixelError = 1.0f;
+    float lodHysteresis = 0.25f;
 
     // Constructor, expects a filepath to a 3D model.
-    Model(const std::string& path);
+    Model(const std::string& path, const ImportOptions& options = ImportOptions());
+    // Releases the model's texture references.
+    ~Model();
+
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
 
     // Draw the model (and thus all its meshes)
     void Draw(Shader& shader);
+    // Same, each mesh at the level picked by SelectLods
+    void Draw(Shader& shader, const LodSelection& lods);
+    // Same, leaving out the clusters of full-detail meshes that culling rejects
+    void Draw(Shader& shader, const LodSelection& lods, const ClusterCulling& culling);
+
+    // Picks each mesh's LOD for one instance from its projected error in pixels.
+    void SelectLods(LodSelection& lods, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection,
+        float viewportHeight) const;
+
+    // Tells the texture streamer how large each mesh's textures appear on screen this frame.
+    void UpdateStreaming(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection, float viewportHeight);
+
+    // Lazy loading: uploads the deferred meshes that came into view (plus the prefetch margin).
+    void UpdateVisibility(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection);
+
+    // Meshes still waiting to become visible.
+    size_t PendingMeshes() const { return pending.size(); }
+
+    // Imports a file into the mesh data the cooked cache would store, without touching GL. For tools and benchmarks.
+    static bool ImportMeshes(const std::string& path, const ImportOptions& options, std::vector<MeshData>& out);
 private:
+    // A mesh left in the cooked cache until it is first seen.
+    struct PendingMesh {
+        size_t index;
+        glm::vec3 aabbMin, aabbMax;
+    };
+    std::vector<PendingMesh> pending;
+    // Kept mapped while meshes are pending.
+    CookedModel cooked;
+
+    void drawMeshes(Shader& shader, const LodSelection& lods, const ClusterCulling* culling);
+
     // Loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(const std::string& path);
 
-    // Processes a node in a recursive fashion.
-    void processNode(aiNode* node, const aiScene* scene);
+    // Imports the file through Assimp into CPU-side mesh data, plus the embedded textures ("*0", "*1"...).
+    static bool importModel(const std::string& path, const ImportOptions& options, std::vector<MeshData>& out,
+        std::vector<EncodedImage>& images);
+
+    // Reads the file and runs the selected post-process steps one at a time, timing each one.
+    static const aiScene* readScene(Assimp::Importer& importer, const std::string& path, const ImportOptions& options);
+
+    // A mesh as placed by one node, with the node's transform relative to the root.
+    struct SceneMesh {
+        aiMesh* mesh;
+        glm::mat4 transform;
+    };
+
+    // Collects the meshes of a node and its children, in a recursive fashion.
+    static void processNode(aiNode* node, const aiScene* scene, const glm::mat4& parentTransform, std::vector<SceneMesh>& out);
+
+    // Converts one aiMesh to CPU-side data. Touches no GL or Model state, so it runs on worker threads.
+    static MeshData processMesh(aiMesh* mesh, const aiScene* scene);
+
+    // Lists the material textures of a given type, without loading them. Embedded ones are named "*index".
+    static std::vector<Texture> materialTextureRefs(const aiScene* scene, aiMaterial* mat, aiTextureType type,
+        std::string typeName);
+
+    // Requests every embedded texture at once, so they decode in parallel while the meshes upload.
+    void loadEmbeddedTextures(const std::string& path, const std::vector<EncodedImage>& images);
+
+    // Packs the small diffuse textures of the given meshes into the atlas.
+    void buildAtlas(const std::vector<std::vector<Texture>>& meshTextures);
+
+    // Loads the given textures if they're not loaded yet and fills in their ids.
+    void loadMaterialTextures(std::vector<Texture>& textures);
+
+    // Prints the mesh data kept and released on the CPU, and the process RSS.
+    void reportMemory() const;
 
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene);
+    // Uploads a mesh straight from the cooked cache.
+    void addCookedMesh(size_t index);
 
-    // Checks all material textures of a given type and loads the textures if they're not loaded yet.
-    std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName);
+    // Uploads one mesh and appends it to meshes.
+    void addMesh(MeshData data);
+    // Same for geometry left in memory the model doesn't own, e.g. the cooked cache mapping; data supplies the rest.
+    void addMesh(MeshData data, const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount);
+    // Resolves the textures of the mesh just appended and fills in its bounds, atlas entry and residency.
+    void finishMesh(MeshData& data, const Vertex* vertices, size_t vertexCount);
 };
 
 #endif
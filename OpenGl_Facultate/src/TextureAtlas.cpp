@@ -0,0 +1,179 @@
+#include "TextureAtlas.h"
+#include "MipChain.h"
+#include "TextureLoader.h"
+#include "ThreadPool.h"
+#include <glad/glad.h>
+#include <stb/stb_image.h>
+#include <stb/stb_rect_pack.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+struct SourceImage {
+    int width = 0, height = 0;
+    std::vector<unsigned char> rgba;
+};
+
+// Expands 1-4 component pixels to RGBA8.
+std::vector<unsigned char> toRGBA(const unsigned char* pixels, int w, int h, int n)
+{
+    std::vector<unsigned char> out((size_t)w * h * 4);
+    for (size_t i = 0; i < (size_t)w * h; i++) {
+        const unsigned char* p = pixels + i * n;
+        unsigned char* q = &out[i * 4];
+        q[0] = p[0];
+        q[1] = n >= 3 ? p[1] : p[0];
+        q[2] = n >= 3 ? p[2] : p[0];
+        q[3] = n == 4 ? p[3] : n == 2 ? p[1] : 255;
+    }
+    return out;
+}
+
+int nextPowerOfTwo(int v)
+{
+    int p = 1;
+    while (p < v)
+        p <<= 1;
+    return p;
+}
+
+}
+
+void TextureAtlas::release()
+{
+    texture.reset();
+    layers = 0;
+    entries.clear();
+}
+
+bool TextureAtlas::find(const std::string& path, AtlasEntry& entry) const
+{
+    auto it = entries.find(path);
+    if (it == entries.end())
+        return false;
+    entry = it->second;
+    return true;
+}
+
+void TextureAtlas::build(const std::vector<std::string>& paths, int maxImageSize)
+{
+    release();
+
+    // Decode everything at once on the pool; only the small ones are kept.
+    std::vector<SourceImage> images(paths.size());
+    ThreadPool::shared().parallelFor(paths.size(), [&](size_t i) {
+        int w, h, n;
+        unsigned char* pixels = TextureLoader::decode(paths[i], false, &w, &h, &n);
+        if (!pixels)
+            return;
+        if (w <= maxImageSize && h <= maxImageSize) {
+            images[i].width = w;
+            images[i].height = h;
+            images[i].rgba = toRGBA(pixels, w, h, n);
+        }
+        stbi_image_free(pixels);
+    });
+
+    // Pack in gutter-sized cells, so every rect starts on a texel of each mip level up to log2(gutter).
+    std::vector<stbrp_rect> rects;
+    long long cellArea = 0;
+    int largest = 0;
+    for (size_t i = 0; i < images.size(); i++) {
+        if (images[i].rgba.empty())
+            continue;
+        stbrp_rect r = {};
+        r.id = (int)i;
+        r.w = (images[i].width + 2 * gutter + gutter - 1) / gutter;
+        r.h = (images[i].height + 2 * gutter + gutter - 1) / gutter;
+        if (std::max(r.w, r.h) * gutter > maxLayerSize)
+            continue;
+        cellArea += (long long)r.w * r.h;
+        largest = std::max(largest, std::max(r.w, r.h));
+        rects.push_back(r);
+    }
+    if (rects.empty())
+        return;
+
+    // Smallest square layer that should hold everything with some packing slack.
+    int layerCells = nextPowerOfTwo(std::max(largest, (int)std::ceil(std::sqrt(cellArea * 1.25))));
+    layerCells = std::min(layerCells, maxLayerSize / gutter);
+    int layerSize = layerCells * gutter;
+
+    std::vector<stbrp_node> nodes(layerCells);
+    std::vector<stbrp_rect> pending = rects, placed;
+    std::vector<int> placedLayer;
+    while (!pending.empty()) {
+        stbrp_context context;
+        stbrp_init_target(&context, layerCells, layerCells, nodes.data(), (int)nodes.size());
+        stbrp_pack_rects(&context, pending.data(), (int)pending.size());
+
+        std::vector<stbrp_rect> left;
+        for (stbrp_rect& r : pending) {
+            if (!r.was_packed) {
+                left.push_back(r);
+                continue;
+            }
+            r.x *= gutter;
+            r.y *= gutter;
+            const SourceImage& image = images[r.id];
+            entries[paths[r.id]] = AtlasEntry{ layers, glm::vec4((float)(r.x + gutter) / layerSize,
+                (float)(r.y + gutter) / layerSize, (float)image.width / layerSize, (float)image.height / layerSize) };
+            placed.push_back(r);
+            placedLayer.push_back(layers);
+        }
+        layers++;
+        pending.swap(left);
+    }
+
+    // Copy every image with a border of wrapped texels, so filtering at the edges matches GL_REPEAT.
+    std::vector<std::vector<unsigned char>> pages(layers, std::vector<unsigned char>((size_t)layerSize * layerSize * 4, 0));
+    ThreadPool::shared().parallelFor(placed.size(), [&](size_t p) {
+        const stbrp_rect& r = placed[p];
+        const SourceImage& image = images[r.id];
+        unsigned char* page = pages[placedLayer[p]].data();
+        for (int y = 0; y < r.h * gutter; y++) {
+            int sy = ((y - gutter) % image.height + image.height) % image.height;
+            for (int x = 0; x < r.w * gutter; x++) {
+                int sx = ((x - gutter) % image.width + image.width) % image.width;
+                const unsigned char* src = &image.rgba[((size_t)sy * image.width + sx) * 4];
+                unsigned char* dst = &page[((size_t)(r.y + y) * layerSize + r.x + x) * 4];
+                dst[0] = src[0]; dst[1] = src[1]; dst[2] = src[2]; dst[3] = src[3];
+            }
+        }
+    });
+
+    // Only the mips the gutters protect are kept; coarser ones would mix neighbouring images.
+    int mipLevels = 0;
+    while ((1 << (mipLevels + 1)) <= gutter)
+        mipLevels++;
+    std::vector<std::vector<ImageLevel>> mips(layers);
+    ThreadPool::shared().parallelFor(layers, [&](size_t l) {
+        mips[l] = buildMipChain(pages[l].data(), layerSize, layerSize, 4, true);
+        if ((int)mips[l].size() > mipLevels)
+            mips[l].resize(mipLevels);
+    });
+
+    texture = GLTexture::create();
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture.get());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int level = 0; level <= mipLevels; level++) {
+        int size = std::max(1, layerSize >> level);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, size, size, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        for (int l = 0; l < layers; l++) {
+            const unsigned char* pixels = level == 0 ? pages[l].data() : mips[l][level - 1].pixels.data();
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, l, size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, mipLevels);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    std::cout << "TEXTURE::ATLAS:: " << entries.size() << " of " << paths.size() << " textures in " << layers
+        << " layers of " << layerSize << "x" << layerSize << ", " << mipLevels + 1 << " mip levels, "
+        << 100.0 * cellArea * gutter * gutter / ((double)layers * layerSize * layerSize) << "% used" << std::endl;
+}
@@ -0,0 +1,50 @@
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include <glm/glm.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "GLHandle.h"
+
+// Where a packed image ended up: array layer and UV rectangle (offset in xy, size in zw).
+struct AtlasEntry {
+    int layer;
+    glm::vec4 rect;
+};
+
+// Packs small images into the layers of one GL_TEXTURE_2D_ARRAY with stb_rect_pack, so a whole model
+// samples them through a single binding. Each image is surrounded by a gutter of wrapped texels and
+// aligned to the gutter size, which keeps repeat filtering correct for the first log2(gutter) mips.
+class TextureAtlas {
+public:
+    // Largest layer size; layers shrink to fit when everything is small.
+    int maxLayerSize = 2048;
+    // Gutter width in texels, a power of two. Also the rect alignment and 2^(mip levels).
+    int gutter = 8;
+
+    TextureAtlas() = default;
+
+    TextureAtlas(const TextureAtlas&) = delete;
+    TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+    // Decodes the images on the shared pool and packs those up to maxImageSize texels across.
+    // Images that are larger or fail to decode are left out. GL thread only.
+    void build(const std::vector<std::string>& paths, int maxImageSize);
+
+    // Looks up a packed image by the path it was built from.
+    bool find(const std::string& path, AtlasEntry& entry) const;
+
+    unsigned int textureID() const { return texture.get(); }
+    int layerCount() const { return layers; }
+    size_t imageCount() const { return entries.size(); }
+
+    void release();
+
+private:
+    GLTexture texture;
+    int layers = 0;
+    std::unordered_map<std::string, AtlasEntry> entries;
+};
+
+#endif
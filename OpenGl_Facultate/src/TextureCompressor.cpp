@@ -0,0 +1,170 @@
+#include "TextureCompressor.h"
+#include "MappedFile.h"
+#include "MipChain.h"
+#include "ThreadPool.h"
+#include <glad/glad.h>
+#include <stb/stb_dxt.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+const char CACHE_MAGIC[4] = { 'B', 'C', 'T', 'X' };
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash;
+    uint32_t format;
+    int32_t width;
+    int32_t height;
+    uint32_t levelCount;
+};
+
+// Block rows handed to one task; small levels end up as a single tile.
+const int TILE_BLOCK_ROWS = 8;
+
+bool hasAlpha(const unsigned char* rgba, size_t pixels)
+{
+    for (size_t i = 0; i < pixels; i++)
+        if (rgba[i * 4 + 3] != 255)
+            return true;
+    return false;
+}
+
+std::vector<unsigned char> encodeLevel(const unsigned char* rgba, int w, int h, bool alpha)
+{
+    int blocksX = (w + 3) / 4, blocksY = (h + 3) / 4;
+    size_t blockBytes = alpha ? 16 : 8;
+    std::vector<unsigned char> out(blockBytes * blocksX * blocksY);
+
+    size_t tiles = (blocksY + TILE_BLOCK_ROWS - 1) / TILE_BLOCK_ROWS;
+    ThreadPool::shared().parallelFor(tiles, [&](size_t tile) {
+        int firstRow = (int)tile * TILE_BLOCK_ROWS;
+        int lastRow = std::min(blocksY, firstRow + TILE_BLOCK_ROWS);
+        unsigned char block[16 * 4];
+        for (int by = firstRow; by < lastRow; by++) {
+            for (int bx = 0; bx < blocksX; bx++) {
+                // Gather the 4x4 block, repeating edge pixels past the border.
+                for (int py = 0; py < 4; py++) {
+                    int y = std::min(by * 4 + py, h - 1);
+                    for (int px = 0; px < 4; px++) {
+                        int x = std::min(bx * 4 + px, w - 1);
+                        std::memcpy(&block[(py * 4 + px) * 4], &rgba[((size_t)y * w + x) * 4], 4);
+                    }
+                }
+                stb_compress_dxt_block(&out[((size_t)by * blocksX + bx) * blockBytes], block, alpha ? 1 : 0, STB_DXT_HIGHQUAL);
+            }
+        }
+    });
+    return out;
+}
+
+}
+
+size_t CompressedImage::byteSize() const
+{
+    size_t total = 0;
+    for (const auto& level : levels)
+        total += level.size();
+    return total;
+}
+
+CompressedImage compressImage(const unsigned char* rgba, int width, int height)
+{
+    CompressedImage image;
+    bool alpha = hasAlpha(rgba, (size_t)width * height);
+    image.format = alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    image.width = width;
+    image.height = height;
+
+    image.levels.push_back(encodeLevel(rgba, width, height, alpha));
+    for (const ImageLevel& level : buildMipChain(rgba, width, height, 4, true))
+        image.levels.push_back(encodeLevel(level.pixels.data(), level.width, level.height, alpha));
+    return image;
+}
+
+bool readCompressedCache(const std::string& path, uint64_t sourceHash, CompressedImage& out)
+{
+    MappedFile file;
+    if (!file.open(path))
+        return false;
+
+    CacheHeader header;
+    if (file.size() < sizeof(header))
+        return false;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, CACHE_MAGIC, 4) != 0 || header.version != COMPRESSED_CACHE_VERSION ||
+        header.sourceHash != sourceHash || header.width <= 0 || header.height <= 0)
+        return false;
+
+    out.format = header.format;
+    out.width = header.width;
+    out.height = header.height;
+    out.levels.clear();
+    size_t offset = sizeof(header);
+    for (uint32_t i = 0; i < header.levelCount; i++) {
+        uint32_t size;
+        if (file.size() - offset < sizeof(size))
+            return false;
+        std::memcpy(&size, file.data() + offset, sizeof(size));
+        offset += sizeof(size);
+        if (file.size() - offset < size)
+            return false;
+        out.levels.emplace_back(file.data() + offset, file.data() + offset + size);
+        offset += size;
+    }
+    return !out.levels.empty();
+}
+
+bool writeCompressedCache(const std::string& path, uint64_t sourceHash, const CompressedImage& image)
+{
+    CacheHeader header;
+    std::memcpy(header.magic, CACHE_MAGIC, 4);
+    header.version = COMPRESSED_CACHE_VERSION;
+    header.sourceHash = sourceHash;
+    header.format = image.format;
+    header.width = image.width;
+    header.height = image.height;
+    header.levelCount = (uint32_t)image.levels.size();
+
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream f(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!f)
+            return false;
+        f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const auto& level : image.levels) {
+            uint32_t size = (uint32_t)level.size();
+            f.write(reinterpret_cast<const char*>(&size), sizeof(size));
+            f.write(reinterpret_cast<const char*>(level.data()), level.size());
+        }
+        if (!f) {
+            f.close();
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+    }
+    std::remove(path.c_str());
+    return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+bool s3tcSupported()
+{
+    static int supported = -1;
+    if (supported < 0) {
+        supported = 0;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++) {
+            const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+            if (name && std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0) {
+                supported = 1;
+                break;
+            }
+        }
+    }
+    return supported == 1;
+}
@@ -0,0 +1,38 @@
+#ifndef TEXTURE_COMPRESSOR_H
+#define TEXTURE_COMPRESSOR_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// GL_EXT_texture_compression_s3tc formats, not part of the core profile glad was generated for.
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// BC1 (opaque) or BC3 (with alpha) texture with its full mip chain, ready for glCompressedTexImage2D.
+struct CompressedImage {
+    unsigned int format = 0;
+    int width = 0, height = 0;
+    std::vector<std::vector<unsigned char>> levels;
+
+    size_t byteSize() const;
+};
+
+// Bump whenever the encoder settings or the cache layout change.
+const uint32_t COMPRESSED_CACHE_VERSION = 3;
+
+// Encodes an RGBA8 image and its mip chain, splitting every level into block rows across the shared pool.
+CompressedImage compressImage(const unsigned char* rgba, int width, int height);
+
+// On-disk cache next to the source image, keyed by the source content hash.
+bool readCompressedCache(const std::string& path, uint64_t sourceHash, CompressedImage& out);
+bool writeCompressedCache(const std::string& path, uint64_t sourceHash, const CompressedImage& image);
+
+// True if the current context can sample S3TC textures. GL thread only.
+bool s3tcSupported();
+
+#endif
@@ -0,0 +1,299 @@
+#include "TextureLoader.h"
+#include "MappedFile.h"
+#include "TextureStreamer.h"
+#include "ThreadPool.h"
+#include <glad/glad.h>
+#include <stb/stb_image.h>
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+GLenum pixelFormatFor(int components)
+{
+    return components == 1 ? GL_RED : components == 2 ? GL_RG : components == 3 ? GL_RGB : GL_RGBA;
+}
+
+// VRAM per texel: drivers keep RGB8 as RGBA8, R8 and RG8 as they are.
+size_t gpuBytesPerTexel(int components)
+{
+    return components == 3 ? 4 : (size_t)components;
+}
+
+}
+
+TextureLoader& TextureLoader::instance()
+{
+    // Touch the pool first so it outlives the loader and its in-flight decodes.
+    ThreadPool::shared();
+    static TextureLoader loader;
+    return loader;
+}
+
+TextureLoader::~TextureLoader()
+{
+    while (inFlight.load() > 0)
+        std::this_thread::yield();
+    DecodedImage* lists[2] = { readyHead.exchange(nullptr), backlog };
+    for (DecodedImage* image : lists) {
+        while (image) {
+            DecodedImage* next = image->next;
+            stbi_image_free(image->pixels);
+            delete image;
+            image = next;
+        }
+    }
+}
+
+unsigned char* TextureLoader::decode(const std::string& path, bool flipVertically, int* width, int* height, int* components)
+{
+    // Read through MappedFile so packed assets resolve like loose files.
+    MappedFile file;
+    if (!file.open(path))
+        return nullptr;
+    return decode(file.data(), file.size(), flipVertically, width, height, components);
+}
+
+unsigned char* TextureLoader::decode(const unsigned char* data, size_t size, bool flipVertically, int* width, int* height,
+    int* components)
+{
+    // The thread-local flag overrides the global one, so concurrent decodes can't race on it.
+    stbi_set_flip_vertically_on_load_thread(flipVertically ? 1 : 0);
+    // Grey+alpha comes back as RGBA, so it samples as grey rather than as red and green.
+    int sourceComponents = 0;
+    int wanted = stbi_info_from_memory(data, (int)size, width, height, &sourceComponents) && sourceComponents == 2 ? 4 : 0;
+    unsigned char* pixels = stbi_load_from_memory(data, (int)size, width, height, components, wanted);
+    if (pixels && wanted)
+        *components = wanted;
+    return pixels;
+}
+
+unsigned int TextureLoader::request(const std::string& path, bool flipVertically)
+{
+    return request(path, EncodedImage(), flipVertically);
+}
+
+unsigned int TextureLoader::request(const std::string& name, const EncodedImage& encoded, bool flipVertically)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+
+    // 1x1 mid-grey placeholder, complete under the final sampling state.
+    const unsigned char placeholder[4] = { 128, 128, 128, 255 };
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    if (compressTextures && !s3tcSupported()) {
+        std::cout << "WARNING::TEXTURE::S3TC_UNSUPPORTED, loading uncompressed" << std::endl;
+        compressTextures = false;
+    }
+    if (requested++ == 0)
+        firstRequest = std::chrono::steady_clock::now();
+
+    inFlight++;
+    bool compress = compressTextures;
+    uint64_t ticket = ++nextTicket;
+    liveRequests[textureID] = ticket;
+    ThreadPool::shared().enqueue([this, textureID, ticket, name, encoded, flipVertically, compress]() {
+        DecodedImage* image = new DecodedImage();
+        image->textureID = textureID;
+        image->ticket = ticket;
+        image->path = name;
+        image->source = encoded;
+        image->pixels = nullptr;
+        load(image, flipVertically, compress);
+        image->source = EncodedImage();
+        push(image);
+        inFlight--;
+    });
+    return textureID;
+}
+
+void TextureLoader::cancel(unsigned int textureID)
+{
+    liveRequests.erase(textureID);
+}
+
+void TextureLoader::load(DecodedImage* image, bool flipVertically, bool compress)
+{
+    auto micros = [](std::chrono::steady_clock::time_point since) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - since).count();
+    };
+    auto start = std::chrono::steady_clock::now();
+    // Embedded images are decoded where they sit; files are mapped.
+    MappedFile file;
+    const unsigned char* bytes = image->source.data.get();
+    size_t size = image->source.size;
+    if (!bytes && file.open(image->path)) {
+        bytes = file.data();
+        size = file.size();
+    }
+    if (!bytes)
+        return;
+
+    if (!compress) {
+        image->pixels = decode(bytes, size, flipVertically, &image->width, &image->height, &image->components);
+        decodeMicros += micros(start);
+        if (image->pixels) {
+            start = std::chrono::steady_clock::now();
+            // Models only bring diffuse and specular maps, authored as colour; single-channel ones are masks.
+            image->mips = buildMipChain(image->pixels, image->width, image->height, image->components,
+                image->components >= 3);
+            mipMicros += micros(start);
+        }
+        return;
+    }
+
+    uint64_t hash = hashBytes(bytes, size, flipVertically ? 1 : 0);
+    std::string cachePath = image->path + ".dxt";
+    if (readCompressedCache(cachePath, hash, image->compressed)) {
+        image->width = image->compressed.width;
+        image->height = image->compressed.height;
+        image->components = 4;
+        cacheHits++;
+        decodeMicros += micros(start);
+        return;
+    }
+
+    stbi_set_flip_vertically_on_load_thread(flipVertically ? 1 : 0);
+    int sourceComponents;
+    unsigned char* rgba = stbi_load_from_memory(bytes, (int)size,
+        &image->width, &image->height, &sourceComponents, 4);
+    decodeMicros += micros(start);
+    if (!rgba)
+        return;
+    image->components = 4;
+
+    start = std::chrono::steady_clock::now();
+    image->compressed = compressImage(rgba, image->width, image->height);
+    stbi_image_free(rgba);
+    encodeMicros += micros(start);
+    if (!writeCompressedCache(cachePath, hash, image->compressed))
+        std::cout << "WARNING::TEXTURE::CACHE_WRITE_FAILED::" << cachePath << std::endl;
+}
+
+void TextureLoader::push(DecodedImage* image)
+{
+    image->next = readyHead.load(std::memory_order_relaxed);
+    while (!readyHead.compare_exchange_weak(image->next, image,
+        std::memory_order_release, std::memory_order_relaxed)) {
+    }
+}
+
+int TextureLoader::uploadReady(int maxUploads)
+{
+    // Take everything the workers finished in one exchange and append it to what is left over.
+    DecodedImage* ready = readyHead.exchange(nullptr, std::memory_order_acquire);
+    while (ready) {
+        DecodedImage* next = ready->next;
+        ready->next = backlog;
+        backlog = ready;
+        ready = next;
+    }
+
+    int count = 0;
+    while (backlog && count < maxUploads) {
+        DecodedImage* image = backlog;
+        backlog = image->next;
+        bool decoded = image->pixels || !image->compressed.levels.empty();
+
+        // Skip textures the registry deleted while they were still decoding.
+        auto live = liveRequests.find(image->textureID);
+        if (live == liveRequests.end() || live->second != image->ticket) {
+            stbi_image_free(image->pixels);
+            delete image;
+            continue;
+        }
+        liveRequests.erase(live);
+
+        if (decoded && streamTextures) {
+            stream(image);
+            count++;
+        }
+        else if (!image->compressed.levels.empty()) {
+            const CompressedImage& c = image->compressed;
+            glBindTexture(GL_TEXTURE_2D, image->textureID);
+            int w = c.width, h = c.height;
+            for (size_t level = 0; level < c.levels.size(); level++) {
+                glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, c.format, w, h, 0,
+                    (GLsizei)c.levels[level].size(), c.levels[level].data());
+                w = std::max(1, w / 2);
+                h = std::max(1, h / 2);
+            }
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)c.levels.size() - 1);
+            vramBytes += c.byteSize();
+            uncompressedBytes += (size_t)c.width * c.height * 4 * 4 / 3;
+            count++;
+        }
+        else if (image->pixels) {
+            GLenum format = pixelFormatFor(image->components);
+
+            // Level by level from the worker-built pyramid, so the driver never generates mips.
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glBindTexture(GL_TEXTURE_2D, image->textureID);
+            glTexImage2D(GL_TEXTURE_2D, 0, format, image->width, image->height, 0, format, GL_UNSIGNED_BYTE, image->pixels);
+            for (size_t i = 0; i < image->mips.size(); i++) {
+                const ImageLevel& level = image->mips[i];
+                glTexImage2D(GL_TEXTURE_2D, (GLint)i + 1, format, level.width, level.height, 0, format, GL_UNSIGNED_BYTE, level.pixels.data());
+            }
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image->mips.size());
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            stbi_image_free(image->pixels);
+            size_t bytes = (size_t)image->width * image->height * gpuBytesPerTexel(image->components) * 4 / 3;
+            vramBytes += bytes;
+            uncompressedBytes += bytes;
+            count++;
+        }
+        else {
+            // The placeholder stays bound to this texture.
+            std::cout << "Texture failed to load at path: " << image->path << std::endl;
+        }
+        delete image;
+    }
+    if (count) {
+        uploaded += count;
+        lastUpload = std::chrono::steady_clock::now();
+    }
+    return count;
+}
+
+void TextureLoader::stream(DecodedImage* image)
+{
+    std::vector<ImageLevel> levels;
+    unsigned int pixelFormat = 0;
+    const CompressedImage& c = image->compressed;
+    if (!c.levels.empty()) {
+        int w = c.width, h = c.height;
+        for (const auto& data : c.levels) {
+            levels.push_back(ImageLevel{ w, h, data });
+            w = std::max(1, w / 2);
+            h = std::max(1, h / 2);
+        }
+        uncompressedBytes += (size_t)c.width * c.height * 4 * 4 / 3;
+    }
+    else {
+        pixelFormat = pixelFormatFor(image->components);
+        size_t size = (size_t)image->width * image->height * image->components;
+        levels.push_back(ImageLevel{ image->width, image->height, std::vector<unsigned char>(image->pixels, image->pixels + size) });
+        stbi_image_free(image->pixels);
+        image->pixels = nullptr;
+        for (ImageLevel& level : image->mips)
+            levels.push_back(std::move(level));
+        uncompressedBytes += (size_t)image->width * image->height * gpuBytesPerTexel(image->components) * 4 / 3;
+    }
+    TextureStreamer::instance().add(image->textureID, std::move(levels), pixelFormat, c.format);
+}
+
+void TextureLoader::report() const
+{
+    double loadMs = uploaded ? std::chrono::duration<double, std::milli>(lastUpload - firstRequest).count() : 0.0;
+    std::cout << "TEXTURE::LOADER:: " << uploaded << "/" << requested << " textures ready in " << loadMs << " ms"
+        << " (decode " << decodeMicros.load() / 1000.0 << " ms, mips " << mipMicros.load() / 1000.0
+        << " ms, BC encode " << encodeMicros.load() / 1000.0
+        << " ms, cache hits " << cacheHits.load() << "), VRAM " << vramBytes / (1024.0 * 1024.0)
+        << " MB vs " << uncompressedBytes / (1024.0 * 1024.0) << " MB uncompressed" << std::endl;
+}
@@ -0,0 +1,96 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "MipChain.h"
+#include "TextureCompressor.h"
+
+// An encoded image file already in memory, such as a texture embedded in a model. data shares ownership
+// of whatever holds the bytes (the Assimp scene, a mapping), which is released once the image is decoded.
+struct EncodedImage {
+    std::shared_ptr<const unsigned char> data;
+    size_t size = 0;
+};
+
+// Decodes textures on the worker pool and uploads them on the GL thread.
+// Each request gets its GL texture immediately, filled with a 1x1 placeholder until the real image is uploaded.
+class TextureLoader {
+public:
+    // Encode textures to BC1/BC3 on the workers (cached next to the source as <file>.dxt).
+    // Set before the first request; ignored when the driver lacks S3TC.
+    bool compressTextures = false;
+    // Hand finished pyramids to TextureStreamer, which uploads only the low mips at first.
+    bool streamTextures = false;
+
+    // Creates the texture and queues the file for decoding. GL thread only.
+    unsigned int request(const std::string& path, bool flipVertically = false);
+    // Same for bytes already in memory; name stands in for the path in messages and the BC cache.
+    unsigned int request(const std::string& name, const EncodedImage& encoded, bool flipVertically = false);
+
+    // Drops the pending decode of a texture that is about to be deleted, so it is never uploaded into
+    // a later texture that reuses the name. GL thread only.
+    void cancel(unsigned int textureID);
+
+    // Uploads up to maxUploads finished decodes, returns how many were uploaded. GL thread only, once per frame.
+    int uploadReady(int maxUploads = 4);
+
+    // True once every requested texture has been uploaded.
+    bool idle() const { return inFlight.load() == 0 && readyHead.load() == nullptr && !backlog; }
+
+    // Decodes an image with a per-call vertical flip, safe to call from any thread. Free with stbi_image_free.
+    // components is 1, 3 or 4: grey+alpha images are expanded to RGBA.
+    static unsigned char* decode(const std::string& path, bool flipVertically, int* width, int* height, int* components);
+    static unsigned char* decode(const unsigned char* data, size_t size, bool flipVertically, int* width, int* height,
+        int* components);
+
+    // Prints load time, encode time and VRAM, compressed against the uncompressed estimate.
+    void report() const;
+
+    static TextureLoader& instance();
+
+    ~TextureLoader();
+
+private:
+    // Pixels decoded on a worker, linked into the ready stack.
+    struct DecodedImage {
+        unsigned int textureID;
+        uint64_t ticket;  // matches liveRequests[textureID] unless the request was cancelled
+        std::string path;
+        EncodedImage source;  // read instead of the file at path when set; dropped after decoding
+        int width, height, components;
+        unsigned char* pixels;  // stbi-owned level 0, nullptr if decoding failed or compressed
+        std::vector<ImageLevel> mips;  // levels 1..n, built on the worker
+        CompressedImage compressed;  // used instead of pixels when it has levels
+        DecodedImage* next;
+    };
+
+    // Lock-free multi-producer stack: workers push, the GL thread takes the whole list at once.
+    std::atomic<DecodedImage*> readyHead{ nullptr };
+    std::atomic<int> inFlight{ 0 };
+    // Decoded but not yet uploaded, kept when uploadReady stops at maxUploads.
+    DecodedImage* backlog = nullptr;
+    // Ticket of the request each texture is waiting on, GL thread only. GL reuses texture names,
+    // so the ticket rather than the name tells a stale decode from a live one.
+    std::unordered_map<unsigned int, uint64_t> liveRequests;
+    uint64_t nextTicket = 0;
+
+    // Statistics for report(); worker timings in microseconds.
+    std::chrono::steady_clock::time_point firstRequest, lastUpload;
+    int requested = 0, uploaded = 0;
+    std::atomic<long long> decodeMicros{ 0 }, mipMicros{ 0 }, encodeMicros{ 0 };
+    std::atomic<int> cacheHits{ 0 };
+    size_t vramBytes = 0, uncompressedBytes = 0;
+
+    TextureLoader() = default;
+    void push(DecodedImage* image);
+    void stream(DecodedImage* image);
+    void load(DecodedImage* image, bool flipVertically, bool compress);
+};
+
+#endif
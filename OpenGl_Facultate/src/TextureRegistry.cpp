@@ -0,0 +1,101 @@
+#include "TextureRegistry.h"
+#include "MappedFile.h"
+#include "TextureLoader.h"
+#include "TextureStreamer.h"
+#include <glad/glad.h>
+#include <stb/stb_image.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+TextureRegistry& TextureRegistry::instance()
+{
+    static TextureRegistry registry;
+    return registry;
+}
+
+unsigned int TextureRegistry::acquire(const std::string& path)
+{
+    std::string key = normalizePath(path);
+
+    // Content hash once per distinct path; later lookups are a single map probe.
+    auto known = hashByPath.find(key);
+    uint64_t hash;
+    size_t bytes = 0;
+    if (known != hashByPath.end()) {
+        hash = known->second;
+    }
+    else {
+        MappedFile file;
+        if (file.open(key)) {
+            hash = hashBytes(file.data(), file.size());
+            int w, h, n;
+            if (stbi_info_from_memory(file.data(), (int)file.size(), &w, &h, &n))
+                bytes = (size_t)w * h * n * 4 / 3;
+        }
+        else {
+            // Missing file: key it by path, the loader reports the failure.
+            hash = hashBytes(key.data(), key.size());
+        }
+        hashByPath[key] = hash;
+    }
+    return acquireHashed(hash, bytes, key, EncodedImage());
+}
+
+unsigned int TextureRegistry::acquire(const std::string& name, const EncodedImage& encoded)
+{
+    // Hashed like a file, so an embedded image shares the texture of an identical loose one.
+    if (!encoded.data)
+        return acquireHashed(hashBytes(name.data(), name.size()), 0, name, encoded);
+    size_t bytes = 0;
+    int w, h, n;
+    if (stbi_info_from_memory(encoded.data.get(), (int)encoded.size, &w, &h, &n))
+        bytes = (size_t)w * h * n * 4 / 3;
+    return acquireHashed(hashBytes(encoded.data.get(), encoded.size), bytes, name, encoded);
+}
+
+unsigned int TextureRegistry::acquireHashed(uint64_t hash, size_t bytes, const std::string& name, const EncodedImage& encoded)
+{
+    auto it = entries.find(hash);
+    if (it != entries.end()) {
+        it->second.refCount++;
+        return it->second.texture.get();
+    }
+
+    Entry entry;
+    entry.texture = GLTexture(TextureLoader::instance().request(name, encoded));
+    entry.contentHash = hash;
+    entry.refCount = 1;
+    entry.bytes = bytes;
+    unsigned int id = entry.texture.get();
+    entries.emplace(hash, std::move(entry));
+    hashById[id] = hash;
+    residentBytes += bytes;
+    return id;
+}
+
+void TextureRegistry::release(unsigned int textureID)
+{
+    auto byId = hashById.find(textureID);
+    if (byId == hashById.end())
+        return;
+    auto it = entries.find(byId->second);
+    if (--it->second.refCount > 0)
+        return;
+
+    TextureLoader::instance().cancel(textureID);
+    TextureStreamer::instance().forget(textureID);
+    residentBytes -= it->second.bytes;
+    entries.erase(it);  // deletes the GL texture
+    hashById.erase(byId);
+}
+
+void TextureRegistry::report() const
+{
+    size_t savedBytes = 0;
+    for (const auto& it : entries)
+        savedBytes += (size_t)(it.second.refCount - 1) * it.second.bytes;
+    std::cout << "TEXTURE::REGISTRY:: " << entries.size() << " textures, "
+        << residentBytes / (1024.0 * 1024.0) << " MB resident, "
+        << savedBytes / (1024.0 * 1024.0) << " MB saved by deduplication" << std::endl;
+}
@@ -0,0 +1,47 @@
+#ifndef TEXTURE_REGISTRY_H
+#define TEXTURE_REGISTRY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include "GLHandle.h"
+#include "TextureLoader.h"
+
+// Process-wide texture cache keyed by normalized path and file content.
+// Every acquire must be paired with a release; the GL texture is deleted with the last reference.
+class TextureRegistry {
+public:
+    // Returns the texture for the file, shared with every other user of the same path or content.
+    unsigned int acquire(const std::string& path);
+    // Same for an image already in memory, e.g. embedded in a model; name only labels it.
+    unsigned int acquire(const std::string& name, const EncodedImage& encoded);
+
+    // Drops one reference to a texture returned by acquire; the last one deletes it.
+    void release(unsigned int textureID);
+
+    // Prints texture count, estimated VRAM and what deduplication saved.
+    void report() const;
+
+    static TextureRegistry& instance();
+
+private:
+    struct Entry {
+        GLTexture texture;
+        uint64_t contentHash;
+        int refCount;
+        size_t bytes;   // estimated VRAM, mip chain included
+    };
+
+    std::unordered_map<std::string, uint64_t> hashByPath;
+    std::unordered_map<uint64_t, Entry> entries;
+    std::unordered_map<unsigned int, uint64_t> hashById;
+
+    size_t residentBytes = 0;
+
+    TextureRegistry() = default;
+    // Shares the entry with this content hash, or creates it and queues the decode.
+    unsigned int acquireHashed(uint64_t hash, size_t bytes, const std::string& name, const EncodedImage& encoded);
+};
+
+#endif
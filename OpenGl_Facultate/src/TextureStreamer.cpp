@@ -0,0 +1,212 @@
+#include "TextureStreamer.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+TextureStreamer& TextureStreamer::instance()
+{
+    static TextureStreamer streamer;
+    return streamer;
+}
+
+int TextureStreamer::coarsestInitialLevel(const Residency& r) const
+{
+    for (size_t i = 0; i < r.levels.size(); i++)
+        if (std::max(r.levels[i].width, r.levels[i].height) <= initialMaxSize)
+            return (int)i;
+    return (int)r.levels.size() - 1;
+}
+
+void TextureStreamer::add(unsigned int textureID, std::vector<ImageLevel> levels, unsigned int pixelFormat, unsigned int compressedFormat)
+{
+    if (levels.empty())
+        return;
+    forget(textureID);
+
+    Residency& r = table[textureID];
+    r.levels = std::move(levels);
+    for (const ImageLevel& level : r.levels)
+        r.levelBytes.push_back(level.pixels.size());
+    r.pixelFormat = pixelFormat;
+    r.compressedFormat = compressedFormat;
+    r.baseLevel = (int)r.levels.size();
+    r.wantedLevel = (int)r.levels.size();
+    r.residentBytes = 0;
+
+    // Coarse to fine, so the texture is complete after every step. The coarsest level always goes up;
+    // finer ones only while they fit the budget.
+    int initial = coarsestInitialLevel(r);
+    for (int level = (int)r.levels.size() - 1; level >= initial; level--) {
+        size_t bytes = r.levelBytes[level];
+        if (level < (int)r.levels.size() - 1 && residentBytes + bytes > budgetBytes && !makeRoom(bytes, textureID))
+            break;
+        upload(textureID, r, level);
+        r.baseLevel = level;
+    }
+    r.targetLevel = r.baseLevel;
+    applyRange(textureID, r);
+    // Drop the 1x1 placeholder the loader left in level 0; it was never counted.
+    if (r.baseLevel > 0)
+        evict(textureID, r, 0, false);
+}
+
+void TextureStreamer::forget(unsigned int textureID)
+{
+    auto it = table.find(textureID);
+    if (it == table.end())
+        return;
+    residentBytes -= it->second.residentBytes;
+    table.erase(it);
+}
+
+void TextureStreamer::requestResolution(unsigned int textureID, float texels)
+{
+    auto it = table.find(textureID);
+    if (it == table.end())
+        return;
+    Residency& r = it->second;
+    float size = (float)std::max(r.levels[0].width, r.levels[0].height);
+    int level = texels > 0.0f ? (int)std::floor(std::log2(std::max(1.0f, size / texels))) : (int)r.levels.size() - 1;
+    level = std::min(level, (int)r.levels.size() - 1);
+    r.wantedLevel = std::min(r.wantedLevel, level);
+}
+
+void TextureStreamer::update()
+{
+    std::vector<std::pair<int, unsigned int>> upgrades;  // (levels missing, texture)
+
+    for (auto& it : table) {
+        Residency& r = it.second;
+        int initial = coarsestInitialLevel(r);
+        int target = std::min(r.wantedLevel, initial);
+        r.wantedLevel = (int)r.levels.size();
+        r.targetLevel = target;
+
+        if (target > r.baseLevel + 1) {
+            // One level of hysteresis, so textures at a mip boundary don't flip every frame.
+            int oldBase = r.baseLevel;
+            r.baseLevel = target;
+            applyRange(it.first, r);
+            for (int level = oldBase; level < target; level++)
+                evict(it.first, r, level, true);
+        }
+        else if (target < r.baseLevel) {
+            upgrades.push_back(std::make_pair(r.baseLevel - target, it.first));
+            // Park the target until the upgrade pass below.
+            r.wantedLevel = target;
+        }
+    }
+
+    // Largest deficit first, one level at a time, within the per-frame and total budgets. A full budget
+    // is first relieved by the textures holding more than they need.
+    std::sort(upgrades.begin(), upgrades.end(),
+        [](const std::pair<int, unsigned int>& a, const std::pair<int, unsigned int>& b) {
+            return a.first != b.first ? a.first > b.first : a.second < b.second;
+        });
+    size_t uploadedBytes = 0;
+    for (const auto& upgrade : upgrades) {
+        Residency& r = table[upgrade.second];
+        int target = r.wantedLevel;
+        r.wantedLevel = (int)r.levels.size();
+        while (r.baseLevel > target) {
+            size_t bytes = r.levelBytes[r.baseLevel - 1];
+            if (uploadedBytes + bytes > uploadBytesPerFrame)
+                break;
+            if (residentBytes + bytes > budgetBytes && !makeRoom(bytes, upgrade.second))
+                break;
+            upload(upgrade.second, r, r.baseLevel - 1);
+            r.baseLevel--;
+            uploadedBytes += bytes;
+        }
+        applyRange(upgrade.second, r);
+    }
+}
+
+bool TextureStreamer::makeRoom(size_t bytes, unsigned int keepID)
+{
+    std::vector<std::pair<int, unsigned int>> surplus;  // (levels beyond target, texture)
+    for (const auto& it : table)
+        if (it.first != keepID && it.second.baseLevel < it.second.targetLevel)
+            surplus.push_back(std::make_pair(it.second.targetLevel - it.second.baseLevel, it.first));
+    std::sort(surplus.begin(), surplus.end(),
+        [](const std::pair<int, unsigned int>& a, const std::pair<int, unsigned int>& b) {
+            return a.first != b.first ? a.first > b.first : a.second < b.second;
+        });
+
+    for (const auto& s : surplus) {
+        Residency& r = table[s.second];
+        while (r.baseLevel < r.targetLevel && residentBytes + bytes > budgetBytes) {
+            int level = r.baseLevel++;
+            applyRange(s.second, r);
+            evict(s.second, r, level, true);
+        }
+        if (residentBytes + bytes <= budgetBytes)
+            return true;
+    }
+    return residentBytes + bytes <= budgetBytes;
+}
+
+void TextureStreamer::upload(unsigned int textureID, Residency& r, int level)
+{
+    ImageLevel& l = r.levels[level];
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    if (r.compressedFormat) {
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, r.compressedFormat, l.width, l.height, 0,
+            (GLsizei)l.pixels.size(), l.pixels.data());
+    }
+    else {
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, level, r.pixelFormat, l.width, l.height, 0, r.pixelFormat, GL_UNSIGNED_BYTE, l.pixels.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+    r.residentBytes += r.levelBytes[level];
+    residentBytes += r.levelBytes[level];
+    std::vector<unsigned char>().swap(l.pixels);
+}
+
+void TextureStreamer::evict(unsigned int textureID, Residency& r, int level, bool resident)
+{
+    // Re-specifying a level as 0x0 releases its storage; it sits below BASE_LEVEL, so the texture stays complete.
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    if (resident) {
+        // Read the level back first so it can be uploaded again. This waits on the GPU, but evictions
+        // only happen on mip changes, never per frame.
+        ImageLevel& l = r.levels[level];
+        l.pixels.resize(r.levelBytes[level]);
+        if (r.compressedFormat)
+            glGetCompressedTexImage(GL_TEXTURE_2D, level, l.pixels.data());
+        else {
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glGetTexImage(GL_TEXTURE_2D, level, r.pixelFormat, GL_UNSIGNED_BYTE, l.pixels.data());
+            glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        }
+    }
+    if (r.compressedFormat)
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, r.compressedFormat, 0, 0, 0, 0, nullptr);
+    else
+        glTexImage2D(GL_TEXTURE_2D, level, r.pixelFormat, 0, 0, 0, r.pixelFormat, GL_UNSIGNED_BYTE, nullptr);
+
+    if (resident) {
+        r.residentBytes -= r.levelBytes[level];
+        residentBytes -= r.levelBytes[level];
+    }
+}
+
+void TextureStreamer::applyRange(unsigned int textureID, const Residency& r)
+{
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, r.baseLevel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)r.levels.size() - 1);
+}
+
+void TextureStreamer::report() const
+{
+    size_t fullBytes = 0;
+    for (const auto& it : table)
+        for (size_t bytes : it.second.levelBytes)
+            fullBytes += bytes;
+    std::cout << "TEXTURE::STREAMER:: " << table.size() << " textures, " << residentBytes / (1024.0 * 1024.0)
+        << " MB resident of " << fullBytes / (1024.0 * 1024.0) << " MB full, budget "
+        << budgetBytes / (1024.0 * 1024.0) << " MB" << std::endl;
+}
@@ -0,0 +1,62 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+#include "MipChain.h"
+
+// Keeps only the mips a texture needs on screen resident, within a memory budget.
+// Resident levels are the range [baseLevel, levelCount-1], exposed to sampling through
+// GL_TEXTURE_BASE_LEVEL / GL_TEXTURE_MAX_LEVEL. Only the levels that are not resident keep a CPU copy;
+// an evicted level is read back from the GPU first. GL thread only.
+class TextureStreamer {
+public:
+    // Total bytes the streamed textures may keep resident.
+    size_t budgetBytes = 256u * 1024u * 1024u;
+    // Levels up to this size are uploaded on arrival.
+    int initialMaxSize = 64;
+    // Bytes uploaded per update, to keep frame hitches bounded.
+    size_t uploadBytesPerFrame = 8u * 1024u * 1024u;
+
+    // Takes over a decoded pyramid (level 0 first) and uploads its low mips.
+    // compressedFormat is the GL compressed format, or 0 for 8-bit data in pixelFormat.
+    void add(unsigned int textureID, std::vector<ImageLevel> levels, unsigned int pixelFormat, unsigned int compressedFormat);
+
+    // Stops tracking a texture, e.g. when it is deleted.
+    void forget(unsigned int textureID);
+
+    // Records that the texture covers about `texels` texels across on screen this frame.
+    void requestResolution(unsigned int textureID, float texels);
+
+    // Raises or lowers resident mips to match this frame's requests, then clears them.
+    void update();
+
+    void report() const;
+
+    static TextureStreamer& instance();
+
+private:
+    struct Residency {
+        std::vector<ImageLevel> levels;     // pixels empty while the level is resident
+        std::vector<size_t> levelBytes;
+        unsigned int pixelFormat;
+        unsigned int compressedFormat;
+        int baseLevel;      // finest resident level
+        int wantedLevel;    // finest level requested this frame, levelCount if none
+        int targetLevel;    // finest level the last update settled on; finer resident levels are surplus
+        size_t residentBytes;
+    };
+
+    std::unordered_map<unsigned int, Residency> table;
+    size_t residentBytes = 0;
+
+    TextureStreamer() = default;
+    int coarsestInitialLevel(const Residency& r) const;
+    void upload(unsigned int textureID, Residency& r, int level);
+    void evict(unsigned int textureID, Residency& r, int level, bool resident);
+    void applyRange(unsigned int textureID, const Residency& r);
+    bool makeRoom(size_t bytes, unsigned int keepID);
+};
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Fixed-size pool of worker threads for CPU-side asset work.
+// Tasks must not touch GL; results go back to the context thread through the returned futures.
+class ThreadPool {
+public:
+    // 0 picks one thread per hardware core.
+    explicit ThreadPool(unsigned int threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queues a task and returns a future for its result.
+    template <class F>
+    std::future<decltype(std::declval<F&>()())> enqueue(F&& task);
+
+    // Runs body(0..count-1) across the pool and the calling thread, returns when all are done.
+    // Safe to call from inside a pool task: the caller keeps taking items itself, so it never waits on queued work.
+    void parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+    size_t size() const { return workers.size(); }
+
+    // Process-wide pool shared by the loaders.
+    static ThreadPool& shared();
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    void workerLoop();
+};
+
+template <class F>
+std::future<decltype(std::declval<F&>()())> ThreadPool::enqueue(F&& task)
+{
+    typedef decltype(std::declval<F&>()()) Result;
+    // std::function needs a copyable target, so the packaged_task lives behind a shared_ptr.
+    auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+    std::future<Result> result = packaged->get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push([packaged]() { (*packaged)(); });
+    }
+    wake.notify_one();
+    return result;
+}
+
+#endif
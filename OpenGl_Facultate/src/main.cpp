@@ -3,11 +3,20 @@
 #include <iostream>
 #include "shader.h"
 #include "camera.h"
+#include "AssetPack.h"
+#include "ImportBenchmark.h"
 #include "Model.h"
+#include "TextureLoader.h"
+#include "TextureRegistry.h"
+#include "TextureStreamer.h"
+#include "ThreadPool.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <vector>
 #include <string>
+#include <chrono>
+#include <future>
+#include <memory>
 #include <stb/stb_image.h>
 
 // ── callbacks ──────────────────────────────────────────────────────────
@@ -25,8 +34,47 @@ float  lastX = 400, lastY = 300;
 // ── constants for the shadow map ───────────────────────────────────────
 const unsigned SHADOW_W = 4096, SHADOW_H = 4096;
 
-int main()
+// ── asset pack ─────────────────────────────────────────────────────────
+const char* ASSET_PACK = "assets.pak";  // used instead of the loose files when present
+
+// ── texture loading ────────────────────────────────────────────────────
+const bool BENCH_CUBEMAP_SERIAL = false; // decode the skybox faces once more on one thread, to log what the pool saves
+const bool COMPRESS_TEXTURES = false;  // BC1/BC3 via stb_dxt, cached as <texture>.dxt
+const bool STREAM_TEXTURES = false;    // start with low mips, stream finer ones by on-screen size
+const size_t TEXTURE_BUDGET = 256u * 1024u * 1024u;
+const bool PACK_TEXTURES = false;      // small diffuse maps into one texture array per model
+
+// ── mesh loading ───────────────────────────────────────────────────────
+const bool LAZY_MESHES = false;        // upload meshes from the cooked cache once they come into view
+const bool QUANTIZE_VERTICES = true;   // 16-byte vertices: unorm16 positions, octahedral normals, half UVs
+const bool DEPTH_STREAM = true;        // position-only copy for the shadow pass, which reads nothing else
+const bool COMPRESS_MESH_CACHE = true; // delta/byte-transposed vertices and edge-coded indices in .meshcache
+const bool BATCH_MESHES = true;        // bake node transforms, one mesh (and draw call) per material
+const MeshResidency MESH_RESIDENCY = MeshResidency::DiscardAfterUpload;  // nothing reads the vertices back
+const std::vector<float> LOD_RATIOS = { 0.5f, 0.25f, 0.1f };  // simplified levels, as fractions of the triangles
+const int FOREST_ROWS = 1;             // draw a FOREST_ROWS x FOREST_ROWS grid of trees, each with its own LODs
+const float FOREST_SPACING = 6.f;
+const bool CULL_CLUSTERS = true;       // skip 64-vertex clusters outside the view
+const bool CULL_BACKFACING_CLUSTERS = false;  // the tree is drawn without GL_CULL_FACE, so its back faces show
+
+int main(int argc, char** argv)
 {
+    // --bench-import <model> [--default-io]: time the import without opening a window
+    if (argc >= 3 && std::string(argv[1]) == "--bench-import") {
+        bool mappedIO = !(argc >= 4 && std::string(argv[3]) == "--default-io");
+        return runImportBenchmark(argv[2], mappedIO);
+    }
+    // --bench-codec <model>: mesh codec compression ratios and decode rates
+    if (argc >= 3 && std::string(argv[1]) == "--bench-codec")
+        return runCodecBenchmark(argv[2]);
+    // --build-pack <out.pak> <dir or file>...: pack assets/ (and the model folder) into one file
+    if (argc >= 4 && std::string(argv[1]) == "--build-pack") {
+        std::vector<std::string> inputs(argv + 3, argv + argc);
+        return AssetPack::build(argv[2], inputs) ? 0 : 1;
+    }
+    if (AssetPack::instance().mount(ASSET_PACK))
+        std::cout << "PACK::MOUNT::" << ASSET_PACK << " " << AssetPack::instance().fileCount() << " files\n";
+
     // GLFW / GLAD --------------------------------------------------------
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -52,7 +100,34 @@ int main()
     Shader skyShader("assets/skybox.vs", "assets/skybox.fs");
 
     // ── model (tree) ----------------------------------------------------
-    Model tree("C:/Users/alexx/Downloads/tree/tree1_3ds/Tree1.3ds");
+    TextureLoader::instance().compressTextures = COMPRESS_TEXTURES;
+    TextureLoader::instance().streamTextures = STREAM_TEXTURES;
+    TextureStreamer::instance().budgetBytes = TEXTURE_BUDGET;
+    // heap-allocated so its GL resources can be released before the context goes away
+    ImportOptions treeOptions = ImportOptions::FastRender();
+    treeOptions.packTextures = PACK_TEXTURES;
+    treeOptions.lazyLoad = LAZY_MESHES;
+    treeOptions.residency = MESH_RESIDENCY;
+    treeOptions.quantizeVertices = QUANTIZE_VERTICES;
+    treeOptions.splitLargeMeshes = true;
+    treeOptions.batchByMaterial = BATCH_MESHES;
+    treeOptions.positionStream = DEPTH_STREAM;
+    treeOptions.compressCache = COMPRESS_MESH_CACHE;
+    treeOptions.lodRatios = LOD_RATIOS;
+    treeOptions.buildMeshlets = CULL_CLUSTERS;
+    std::unique_ptr<Model> tree = std::make_unique<Model>("C:/Users/alexx/Downloads/tree/tree1_3ds/Tree1.3ds",
+        treeOptions);
+    // Batching bakes in the node transforms, Assimp's Z-up to Y-up root rotation included; unbatched meshes need it here.
+    glm::mat4 treeUpright = BATCH_MESHES ? glm::mat4(1) : glm::rotate(glm::mat4(1), glm::radians(-90.f), glm::vec3(1, 0, 0));
+    // One transform and LOD selection per tree; the first one is the original at the origin.
+    std::vector<glm::mat4> treeModels;
+    for (int z = 0; z < FOREST_ROWS; z++)
+        for (int x = 0; x < FOREST_ROWS; x++) {
+            glm::vec3 offset((x + 1) / 2 * ((x & 1) ? 1.f : -1.f), 0.f, (z + 1) / 2 * ((z & 1) ? 1.f : -1.f));
+            treeModels.push_back(glm::translate(glm::mat4(1), offset * FOREST_SPACING) * treeUpright);
+        }
+    std::vector<LodSelection> treeLods(treeModels.size());
+    TextureRegistry::instance().report();
 
     // ── ground plane ----------------------------------------------------
     float plane[] = {
@@ -125,16 +200,25 @@ int main()
     litShader.setVec3("light.specular", glm::vec3(1.0f));
     litShader.setFloat("shininess", 32.0f);
     litShader.setInt("shadowMap", 1);           // depthTex bound to unit 1
+    litShader.setInt("atlasTex", ATLAS_TEXTURE_UNIT);
     litShader.setMat4("lightSpaceMatrix", glm::mat4(1)); // placeholder
 
     // ── render loop -----------------------------------------------------
     float last = 0;
+    bool texturesReported = false;
     float sunSpeed = 0.05f;        // revolutions per second  (change to taste)
     while (!glfwWindowShouldClose(win))
     {
         float now = (float)glfwGetTime(), dt = now - last; last = now;
         processInput(win, dt);
 
+        // 0. upload textures the loader threads finished decoding
+        TextureLoader::instance().uploadReady();
+        if (!texturesReported && TextureLoader::instance().idle()) {
+            TextureLoader::instance().report(); texturesReported = true;
+            if (STREAM_TEXTURES) TextureStreamer::instance().report();
+        }
+
         // 1. create light-space matrix (orthographic)
         const float nearP = 1.f, farP = 50.f, ortho = 20.f;
 
@@ -158,10 +242,12 @@ int main()
         depthShader.use();
         depthShader.setMat4("lightSpaceMatrix", lightSpace);
 
-        //   2a. tree (rotated 90° Y)
-        glm::mat4 model = glm::rotate(glm::mat4(1), glm::radians(-90.f), glm::vec3(1, 0, 0));
-        depthShader.setMat4("model", model);
-        tree.Draw(depthShader);
+        //   2a. trees (rotated 90° Y), at the LODs the camera picked last frame
+        for (size_t i = 0; i < treeModels.size(); i++) {
+            depthShader.setMat4("model", treeModels[i]);
+            // Facing the light doesn't matter for what casts a shadow, only the light's frustum does.
+            tree->Draw(depthShader, treeLods[i], ClusterCulling(treeModels[i], lightSpace, glm::vec3(0), false));
+        }
 
         //   2b. plane
         depthShader.setMat4("model", glm::mat4(1));
@@ -179,6 +265,14 @@ int main()
         glm::mat4 view = camera.GetViewMatrix();
         glm::mat4 proj = glm::perspective(glm::radians(45.f), (float)width / height, 0.1f, 100.f);
 
+        //   load tree meshes that came into view, then request the texture mips they need at this distance
+        glm::mat4 model = treeModels[0];
+        tree->UpdateVisibility(model, view, proj);
+        tree->UpdateStreaming(model, view, proj, (float)height);
+        TextureStreamer::instance().update();
+        for (size_t i = 0; i < treeModels.size(); i++)
+            tree->SelectLods(treeLods[i], treeModels[i], view, proj, (float)height);
+
         //   3a. lit objects (plane + tree)
         litShader.use();
         litShader.setVec3("light.direction", lightDir);
@@ -190,9 +284,10 @@ int main()
 
         // tree
         litShader.setBool("useTexture", true);
-        model = glm::rotate(glm::mat4(1), glm::radians(-90.f), glm::vec3(1, 0, 0));
-        litShader.setMat4("model", model);
-        tree.Draw(litShader);
+        for (size_t i = 0; i < treeModels.size(); i++) {
+            litShader.setMat4("model", treeModels[i]);
+            tree->Draw(litShader, treeLods[i], ClusterCulling(treeModels[i], proj * view, camera.Position, CULL_BACKFACING_CLUSTERS));
+        }
 
         // plane
         litShader.setBool("useTexture", false);
@@ -219,7 +314,10 @@ int main()
     // ── cleanup ---------------------------------------------------------
     glDeleteVertexArrays(1, &planeVAO); glDeleteBuffers(1, &planeVBO);
     glDeleteVertexArrays(1, &skyVAO);   glDeleteBuffers(1, &skyVBO); glDeleteBuffers(1, &skyEBO);
-    glDeleteFramebuffers(1, &depthFBO); glDeleteTextures(1, &depthTex);
+    glDeleteFramebuffers(1, &depthFBO); glDeleteTextures(1, &depthTex); glDeleteTextures(1, &cubemap);
+    // The model's buffers and the shader programs go while the context is still current.
+    tree.reset();
+    litShader.ID.reset(); depthShader.ID.reset(); skyShader.ID.reset();
     glfwTerminate();
     return 0;
 }
@@ -249,15 +347,43 @@ void mouse_callback(GLFWwindow*, double xpos, double ypos) {
 
 unsigned int loadCubemap(const std::vector<std::string>& faces)
 {
-    stbi_set_flip_vertically_on_load(false); glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    // decode all faces at once on the loader threads
+    struct Face { unsigned char* data; int w, h, n; };
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::future<Face>> pending;
+    for (const std::string& path : faces)
+        pending.push_back(ThreadPool::shared().enqueue([path]() {
+            Face f;
+            f.data = TextureLoader::decode(path, false, &f.w, &f.h, &f.n);
+            return f;
+        }));
+
+    std::vector<Face> decoded;
+    for (auto& p : pending) decoded.push_back(p.get());
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "CUBEMAP::DECODE:: " << faces.size() << " faces in " << wallMs << " ms";
+    if (BENCH_CUBEMAP_SERIAL) {
+        // Serial baseline on this thread, after the parallel run, so its reads hit a warm file cache
+        // and the saving shown is if anything an underestimate.
+        auto serialStart = std::chrono::steady_clock::now();
+        for (const std::string& path : faces) {
+            int w, h, n;
+            stbi_image_free(TextureLoader::decode(path, false, &w, &h, &n));
+        }
+        double serialMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - serialStart).count();
+        std::cout << " (serial " << serialMs << " ms, saved " << serialMs - wallMs << " ms)";
+    }
+    std::cout << "\n";
+
+    // uploads stay on the GL thread, in face order
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     unsigned int tex; glGenTextures(1, &tex); glBindTexture(GL_TEXTURE_CUBE_MAP, tex);
-    int w, h, n;
     for (unsigned i = 0; i < faces.size(); ++i) {
-        unsigned char* data = stbi_load(faces[i].c_str(), &w, &h, &n, 0);
-        if (data) {
-            GLenum fmt = (n == 4 ? GL_RGBA : GL_RGB);
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, fmt, w, h, 0, fmt, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
+        Face& f = decoded[i];
+        if (f.data) {
+            GLenum fmt = (f.n == 4 ? GL_RGBA : GL_RGB);
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, fmt, f.w, f.h, 0, fmt, GL_UNSIGNED_BYTE, f.data);
+            stbi_image_free(f.data);
         }
         else { std::cerr << "Failed cubemap " << faces[i] << "\n"; }
     }
@@ -1,36 +1,53 @@
 #include "shader.h"
+#include "AssetPack.h"
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <glm/gtc/type_ptr.hpp>
 
+// Reads a shader source from the mounted asset pack, false if it isn't packed.
+static bool readPacked(const char* path, std::string& code)
+{
+    const unsigned char* data;
+    size_t size;
+    std::vector<unsigned char> inflated;
+    if (!AssetPack::instance().isMounted() || !AssetPack::instance().find(path, data, size, inflated))
+        return false;
+    code.assign(reinterpret_cast<const char*>(data), size);
+    return true;
+}
+
 Shader::Shader(const char* vertexPath, const char* fragmentPath)
 {
     std::string vertexCode;
     std::string fragmentCode;
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
-    // Ensure ifstream objects can throw exceptions:
-    vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    try
-    {
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
-        std::stringstream vShaderStream, fShaderStream;
-        // Read file's buffer contents into streams
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-        // Close file handlers
-        vShaderFile.close();
-        fShaderFile.close();
-        // Convert stream into string
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
-    }
-    catch (std::ifstream::failure& e)
+    // Packed shaders come from the asset pack, loose ones from disk
+    if (!readPacked(vertexPath, vertexCode) || !readPacked(fragmentPath, fragmentCode))
     {
-        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+        std::ifstream vShaderFile;
+        std::ifstream fShaderFile;
+        // Ensure ifstream objects can throw exceptions:
+        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        try
+        {
+            vShaderFile.open(vertexPath);
+            fShaderFile.open(fragmentPath);
+            std::stringstream vShaderStream, fShaderStream;
+            // Read file's buffer contents into streams
+            vShaderStream << vShaderFile.rdbuf();
+            fShaderStream << fShaderFile.rdbuf();
+            // Close file handlers
+            vShaderFile.close();
+            fShaderFile.close();
+            // Convert stream into string
+            vertexCode = vShaderStream.str();
+            fragmentCode = fShaderStream.str();
+        }
+        catch (std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+        }
     }
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
@@ -63,16 +80,29 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
     }
 
     // Shader program linking
-    ID = glCreateProgram();
-    glAttachShader(ID, vertex);
-    glAttachShader(ID, fragment);
-    glLinkProgram(ID);
-    glGetProgramiv(ID, GL_LINK_STATUS, &success);
+    ID = GLProgram::create();
+    glAttachShader(ID.get(), vertex);
+    glAttachShader(ID.get(), fragment);
+    glLinkProgram(ID.get());
+    glGetProgramiv(ID.get(), GL_LINK_STATUS, &success);
     if (!success)
     {
-        glGetProgramInfoLog(ID, 512, NULL, infoLog);
+        glGetProgramInfoLog(ID.get(), 512, NULL, infoLog);
         std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
     }
+    // Inactive inputs are optimized out, so this reflects what the shader really fetches
+    GLint attributes = 0;
+    glGetProgramiv(ID.get(), GL_ACTIVE_ATTRIBUTES, &attributes);
+    positionOnly = success && attributes > 0;
+    for (GLint i = 0; i < attributes; i++)
+    {
+        char name[64];
+        GLint size;
+        GLenum type;
+        glGetActiveAttrib(ID.get(), i, sizeof(name), NULL, &size, &type, name);
+        if (glGetAttribLocation(ID.get(), name) != 0)
+            positionOnly = false;
+    }
     // Delete the shaders as they're linked now
     glDeleteShader(vertex);
     glDeleteShader(fragment);
@@ -80,30 +110,35 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
 
 void Shader::use()
 {
-    glUseProgram(ID);
+    glUseProgram(ID.get());
 }
 
 void Shader::setBool(const std::string& name, bool value) const
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    glUniform1i(glGetUniformLocation(ID.get(), name.c_str()), (int)value);
 }
 
 void Shader::setInt(const std::string& name, int value) const
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1i(glGetUniformLocation(ID.get(), name.c_str()), value);
 }
 
 void Shader::setFloat(const std::string& name, float value) const
 {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1f(glGetUniformLocation(ID.get(), name.c_str()), value);
 }
 
 void Shader::setMat4(const std::string& name, const glm::mat4& mat) const
 {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
+    glUniformMatrix4fv(glGetUniformLocation(ID.get(), name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
 }
 
 void Shader::setVec3(const std::string& name, const glm::vec3& value) const
 {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform3fv(glGetUniformLocation(ID.get(), name.c_str()), 1, &value[0]);
+}
+
+void Shader::setVec4(const std::string& name, const glm::vec4& value) const
+{
+    glUniform4fv(glGetUniformLocation(ID.get(), name.c_str()), 1, &value[0]);
 }
\ No newline at end of file
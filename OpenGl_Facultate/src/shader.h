@@ -4,15 +4,22 @@
 #include <string>
 #include <glm/glm.hpp>
 #include <glad/glad.h>
+#include "GLHandle.h"
 
 class Shader {
 public:
-    // The program ID
-    unsigned int ID;
+    // The program, deleted with the Shader
+    GLProgram ID;
+    // True when the only vertex input the program reads is location 0 (position), e.g. depth passes.
+    // Meshes then draw from their position-only stream if they have one.
+    bool positionOnly = false;
 
     // Constructor reads and builds the shader from file paths
     Shader(const char* vertexPath, const char* fragmentPath);
 
+    Shader(Shader&&) = default;
+    Shader& operator=(Shader&&) = default;
+
     // Activate the shader
     void use();
 
@@ -22,6 +29,7 @@ public:
     void setFloat(const std::string& name, float value) const;
     void setMat4(const std::string& name, const glm::mat4& mat) const;
     void setVec3(const std::string& name, const glm::vec3& value) const;
+    void setVec4(const std::string& name, const glm::vec4& value) const;
 };
 
 #endif
@@ -0,0 +1,3 @@
+#include <string.h>  // stb_dxt.h uses memcpy but only includes stdlib.h
+#define STB_DXT_IMPLEMENTATION
+#include <stb/stb_dxt.h>